@@ -21,7 +21,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "arm_data.h"
+#include "util.h"
 
 #ifndef _
 #define _(String) String
@@ -81,22 +83,13 @@ static struct {
     { NULL, NULL }
 };
 
-static struct {
-    int code; char *name;
-} tab_arm_implementer[] = {
-    { 0x41,	"ARM" },
-    { 0x44,	"Intel (formerly DEC) StrongARM" },
-    { 0x4e,	"nVidia" },
-    { 0x54,	"Texas Instruments" },
-    { 0x56,	"Marvell" },
-    { 0x69,	"Intel XScale" },
-    { 0, NULL},
-};
-
-static struct {
+/* parts of each implementer, sorted by code for bsearch() */
+typedef struct {
     /* source: t = tested, d = official docs, f = web */
     int code; char *part_desc;
-} tab_arm_arm_part[] = { /* only valid for implementer 0x41 ARM */
+} arm_part_entry;
+
+static const arm_part_entry tab_arm_arm_part[] = { /* 0x41 ARM */
     /*d */ { 0x920,	"ARM920" },
     /*d */ { 0x926,	"ARM926" },
     /*d */ { 0x946,	"ARM946" },
@@ -109,17 +102,145 @@ static struct {
     /*d */ { 0xc07,	"Cortex-A7 MPCore" },
     /*dt*/ { 0xc08,	"Cortex-A8" },
     /*dt*/ { 0xc09,	"Cortex-A9" },
+    /*d */ { 0xc0d,	"Cortex-A12" },
     /*d */ { 0xc0e,	"Cortex-A17 MPCore" },
     /*d */ { 0xc0f,	"Cortex-A15" },
     /*d */ { 0xd01,	"Cortex-A32" },
+    /*d */ { 0xd02,	"Cortex-A34" },
     /*dt*/ { 0xd03,	"Cortex-A53" },
     /*d */ { 0xd04,	"Cortex-A35" },
     /*d */ { 0xd05,	"Cortex-A55" },
+    /*d */ { 0xd06,	"Cortex-A65" },
     /*d */ { 0xd07,	"Cortex-A57 MPCore" },
     /*d */ { 0xd08,	"Cortex-A72" },
     /*d */ { 0xd09,	"Cortex-A73" },
     /*d */ { 0xd0a,	"Cortex-A75" },
-           { 0, NULL},
+    /*d */ { 0xd0b,	"Cortex-A76" },
+    /*d */ { 0xd0c,	"Neoverse-N1" },
+    /*d */ { 0xd0d,	"Cortex-A77" },
+    /*d */ { 0xd0e,	"Cortex-A76AE" },
+    /*d */ { 0xd40,	"Neoverse-V1" },
+    /*d */ { 0xd41,	"Cortex-A78" },
+    /*d */ { 0xd42,	"Cortex-A78AE" },
+    /*d */ { 0xd43,	"Cortex-A65AE" },
+    /*d */ { 0xd44,	"Cortex-X1" },
+    /*d */ { 0xd46,	"Cortex-A510" },
+    /*d */ { 0xd47,	"Cortex-A710" },
+    /*d */ { 0xd48,	"Cortex-X2" },
+    /*d */ { 0xd49,	"Neoverse-N2" },
+    /*d */ { 0xd4a,	"Neoverse-E1" },
+    /*d */ { 0xd4b,	"Cortex-A78C" },
+    /*d */ { 0xd4c,	"Cortex-X1C" },
+    /*d */ { 0xd4d,	"Cortex-A715" },
+    /*d */ { 0xd4e,	"Cortex-X3" },
+    /*d */ { 0xd4f,	"Neoverse-V2" },
+};
+
+static const arm_part_entry tab_arm_brcm_part[] = { /* 0x42 Broadcom */
+    /*f */ { 0x00f,	"Brahma-B15" },
+    /*f */ { 0x100,	"Brahma-B53" },
+    /*f */ { 0x516,	"Vulcan" },
+};
+
+static const arm_part_entry tab_arm_cavium_part[] = { /* 0x43 Cavium */
+    /*f */ { 0x0a0,	"ThunderX" },
+    /*f */ { 0x0a1,	"ThunderX-88XX" },
+    /*f */ { 0x0a2,	"ThunderX-81XX" },
+    /*f */ { 0x0a3,	"ThunderX-83XX" },
+    /*f */ { 0x0af,	"ThunderX2-99xx" },
+};
+
+static const arm_part_entry tab_arm_fujitsu_part[] = { /* 0x46 Fujitsu */
+    /*f */ { 0x001,	"A64FX" },
+};
+
+static const arm_part_entry tab_arm_hisi_part[] = { /* 0x48 HiSilicon */
+    /*f */ { 0xd01,	"Kunpeng-920" },
+};
+
+static const arm_part_entry tab_arm_nvidia_part[] = { /* 0x4e NVIDIA */
+    /*f */ { 0x000,	"Denver" },
+    /*f */ { 0x003,	"Denver 2" },
+    /*f */ { 0x004,	"Carmel" },
+};
+
+static const arm_part_entry tab_arm_apm_part[] = { /* 0x50 Applied Micro */
+    /*f */ { 0x000,	"X-Gene" },
+};
+
+static const arm_part_entry tab_arm_qcom_part[] = { /* 0x51 Qualcomm */
+    /*f */ { 0x00f,	"Scorpion" },
+    /*f */ { 0x02d,	"Scorpion" },
+    /*f */ { 0x04d,	"Krait" },
+    /*f */ { 0x06f,	"Krait" },
+    /*f */ { 0x201,	"Kryo" },
+    /*f */ { 0x205,	"Kryo" },
+    /*f */ { 0x211,	"Kryo" },
+    /*f */ { 0x800,	"Falkor V1/Kryo" },
+    /*f */ { 0x801,	"Kryo V2" },
+    /*f */ { 0x802,	"Kryo 3XX Gold" },
+    /*f */ { 0x803,	"Kryo 3XX Silver" },
+    /*f */ { 0x804,	"Kryo 4XX Gold" },
+    /*f */ { 0x805,	"Kryo 4XX Silver" },
+    /*f */ { 0xc00,	"Falkor" },
+    /*f */ { 0xc01,	"Saphira" },
+};
+
+static const arm_part_entry tab_arm_samsung_part[] = { /* 0x53 Samsung */
+    /*f */ { 0x001,	"Exynos-M1" },
+    /*f */ { 0x002,	"Exynos-M3" },
+    /*f */ { 0x003,	"Exynos-M4" },
+    /*f */ { 0x004,	"Exynos-M5" },
+};
+
+static const arm_part_entry tab_arm_marvell_part[] = { /* 0x56 Marvell */
+    /*f */ { 0x131,	"Feroceon 88FR131" },
+    /*f */ { 0x581,	"PJ4/PJ4b" },
+    /*f */ { 0x584,	"PJ4B-MP" },
+};
+
+static const arm_part_entry tab_arm_apple_part[] = { /* 0x61 Apple */
+    /*f */ { 0x020,	"Icestorm (A14)" },
+    /*f */ { 0x021,	"Firestorm (A14)" },
+    /*f */ { 0x022,	"Icestorm (M1)" },
+    /*f */ { 0x023,	"Firestorm (M1)" },
+    /*f */ { 0x024,	"Icestorm (M1 Pro)" },
+    /*f */ { 0x025,	"Firestorm (M1 Pro)" },
+    /*f */ { 0x028,	"Icestorm (M1 Max)" },
+    /*f */ { 0x029,	"Firestorm (M1 Max)" },
+    /*f */ { 0x030,	"Blizzard (A15)" },
+    /*f */ { 0x031,	"Avalanche (A15)" },
+    /*f */ { 0x032,	"Blizzard (M2)" },
+    /*f */ { 0x033,	"Avalanche (M2)" },
+};
+
+static const arm_part_entry tab_arm_ampere_part[] = { /* 0xc0 Ampere */
+    /*f */ { 0xac3,	"Ampere-1" },
+    /*f */ { 0xac4,	"Ampere-1a" },
+};
+
+#define PARTS(t) t, sizeof(t) / sizeof(t[0])
+static const struct {
+    int code; char *name;
+    const arm_part_entry *parts; int part_count;
+} tab_arm_implementer[] = { /* sorted by code for bsearch() */
+    { 0x41,	"ARM", PARTS(tab_arm_arm_part) },
+    { 0x42,	"Broadcom", PARTS(tab_arm_brcm_part) },
+    { 0x43,	"Cavium", PARTS(tab_arm_cavium_part) },
+    { 0x44,	"Intel (formerly DEC) StrongARM", NULL, 0 },
+    { 0x46,	"Fujitsu", PARTS(tab_arm_fujitsu_part) },
+    { 0x48,	"HiSilicon", PARTS(tab_arm_hisi_part) },
+    { 0x4d,	"Motorola/Freescale", NULL, 0 },
+    { 0x4e,	"nVidia", PARTS(tab_arm_nvidia_part) },
+    { 0x50,	"Applied Micro", PARTS(tab_arm_apm_part) },
+    { 0x51,	"Qualcomm", PARTS(tab_arm_qcom_part) },
+    { 0x53,	"Samsung", PARTS(tab_arm_samsung_part) },
+    { 0x54,	"Texas Instruments", NULL, 0 },
+    { 0x56,	"Marvell", PARTS(tab_arm_marvell_part) },
+    { 0x61,	"Apple", PARTS(tab_arm_apple_part) },
+    { 0x66,	"Faraday", NULL, 0 },
+    { 0x69,	"Intel XScale", NULL, 0 },
+    { 0xc0,	"Ampere", PARTS(tab_arm_ampere_part) },
 };
 
 static struct {
@@ -147,51 +268,64 @@ const char *arm_flag_list() {
     return all_flags;
 }
 
+/* table order, NULL past the end */
+const char *arm_flag_name(int index) {
+    /* less the NULL row */
+    const int count = sizeof(tab_flag_meaning) / sizeof(tab_flag_meaning[0]) - 1;
+    if (index < 0 || index >= count)
+        return NULL;
+    return tab_flag_meaning[index].name;
+}
+
+static name_index flag_index = NAME_INDEX(tab_flag_meaning, 0);
+static pthread_once_t flag_index_once = PTHREAD_ONCE_INIT;
+
+static void flag_index_make(void) {
+    name_index_make(&flag_index);
+}
+
 const char *arm_flag_meaning(const char *flag) {
-    int i = 0;
-    if (flag)
-    while(tab_flag_meaning[i].name != NULL) {
-        if (strcmp(tab_flag_meaning[i].name, flag) == 0) {
-            if (tab_flag_meaning[i].meaning != NULL)
-                return _(tab_flag_meaning[i].meaning);
-            else return NULL;
-        }
-        i++;
+    int i;
+    if (flag) {
+        pthread_once(&flag_index_once, flag_index_make);
+        i = name_index_find(&flag_index, flag, strlen(flag));
+        if (i >= 0 && tab_flag_meaning[i].meaning != NULL)
+            return _(tab_flag_meaning[i].meaning);
     }
     return NULL;
 }
 
-static int code_match(int c0, const char* code1) {
-    int c1;
-    if (code1 == NULL) return 0;
-    c1 = strtol(code1, NULL, 0);
-    return (c0 == c1) ? 1 : 0;
+/* both tables start with an int code */
+static int code_cmp(const void *key, const void *entry) {
+    return *(const int *)key - *(const int *)entry;
+}
+
+static int imp_find(const char *code) {
+    const void *e;
+    int c;
+    if (!code) return -1;
+    c = strtol(code, NULL, 0);
+    e = bsearch(&c, tab_arm_implementer,
+            sizeof(tab_arm_implementer) / sizeof(tab_arm_implementer[0]),
+            sizeof(tab_arm_implementer[0]), code_cmp);
+    return (e) ? (int)(((const char *)e - (const char *)tab_arm_implementer) / sizeof(tab_arm_implementer[0])) : -1;
 }
 
 const char *arm_implementer(const char *code) {
-    int i = 0;
-    if (code)
-    while(tab_arm_implementer[i].code) {
-        if (code_match(tab_arm_implementer[i].code, code))
-            return tab_arm_implementer[i].name;
-        i++;
-    }
-    return NULL;
+    int i = imp_find(code);
+    return (i >= 0) ? tab_arm_implementer[i].name : NULL;
 }
 
 const char *arm_part(const char *imp_code, const char *part_code) {
-    int i = 0;
-    if (imp_code && part_code) {
-        if (code_match(0x41, imp_code)) {
-            /* 0x41=ARM parts */
-            while(tab_arm_arm_part[i].code) {
-                if (code_match(tab_arm_arm_part[i].code, part_code))
-                    return tab_arm_arm_part[i].part_desc;
-                i++;
-            }
-        }
-    }
-    return NULL;
+    const arm_part_entry *e;
+    int i, c;
+    if (!part_code) return NULL;
+    i = imp_find(imp_code);
+    if (i < 0 || !tab_arm_implementer[i].parts) return NULL;
+    c = strtol(part_code, NULL, 0);
+    e = bsearch(&c, tab_arm_implementer[i].parts, tab_arm_implementer[i].part_count,
+            sizeof(arm_part_entry), code_cmp);
+    return (e) ? e->part_desc : NULL;
 }
 
 const char *arm_arch(const char *cpuinfo_arch_str) {
@@ -36,5 +36,6 @@ char *arm_decoded_name(
 /* cpu flags from /proc/cpuinfo */
 const char *arm_flag_list(void);                  /* list of all known flags */
 const char *arm_flag_meaning(const char *flag);  /* lookup flag meaning */
+const char *arm_flag_name(int index);            /* known flags, in order */
 
 #endif
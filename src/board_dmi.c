@@ -25,6 +25,8 @@
 #include "board_dmi.h"
 
 struct dmi_board {
+    rpiz_arena *arena; /* owns the strings below */
+
     char *board_desc;
 
     char *board_model;
@@ -43,28 +45,28 @@ int dmi_board_check() {
     return dir_exists("/sys/class/dmi/id/");
 }
 
-static char *get_dmi_string(char *p) {
-    char fn[256];
-    char *ret = NULL, *rep = NULL;
+static char *get_dmi_string(rpiz_arena *a, char *p) {
+    char fn[256], buff[256];
+    char *rep = NULL;
     snprintf(fn, 256, "/sys/class/dmi/id/%s", p);
-    ret = get_file_contents(fn);
-    if (ret) {
-        while((rep = strchr(ret, '\n'))) *rep = 0;
-        //DEBUG printf("get_dmi_string( %s ): (len:%d) %s\n", p, (int)strlen(ret), ret);
-    }
-    return ret;
+    if (get_file_contents_buf(fn, buff, sizeof(buff)) < 0)
+        return NULL;
+    while((rep = strchr(buff, '\n'))) *rep = 0;
+    //DEBUG printf("get_dmi_string( %s ): (len:%d) %s\n", p, (int)strlen(buff), buff);
+    return arena_strdup(a, buff);
 }
 
-#define DMI_GET(v,s) v = get_dmi_string(s);
-#define DMI_GET_UNK(v,s) \
-        v = get_dmi_string(s); \
-        if (!v) v = strdup("(Unknown)");
+#define DMI_GET(v,i) v = get_dmi_string(s->arena, i);
+#define DMI_GET_UNK(v,i) \
+        v = get_dmi_string(s->arena, i); \
+        if (!v) v = arena_strdup(s->arena, "(Unknown)");
 
 dmi_board *dmi_board_new() {
     int dlen = 0;
     dmi_board *s = malloc( sizeof(dmi_board) );
     if (s) {
         memset(s, 0, sizeof(*s));
+        s->arena = arena_new();
         DMI_GET_UNK(s->board_model,   "board_name");
         DMI_GET_UNK(s->board_vendor,  "board_vendor");
         DMI_GET_UNK(s->board_version, "board_version");
@@ -74,7 +76,7 @@ dmi_board *dmi_board_new() {
         DMI_GET_UNK(s->bios_version, "bios_version");
 
         dlen = strlen(s->board_model) + strlen(s->board_vendor) + 2;
-        s->board_desc = malloc(dlen);
+        s->board_desc = arena_alloc(s->arena, dlen);
         if (s->board_desc)
             snprintf(s->board_desc, dlen, "%s %s", s->board_vendor, s->board_model);
 
@@ -85,14 +87,8 @@ dmi_board *dmi_board_new() {
 
 void dmi_board_free(dmi_board *s) {
     if (s) {
-        free(s->board_desc);
-        free(s->board_model);
-        free(s->board_vendor);
-        free(s->board_version);
-        free(s->board_serial);
-        free(s->bios_date);
-        free(s->bios_version);
-        free(s->bios_vendor);
+        fields_detach(s->fields);
+        arena_free(s->arena);
         if (s->fields)
             fields_free(s->fields);
         free(s);
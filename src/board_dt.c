@@ -25,6 +25,8 @@
 #include "board_dt.h"
 
 struct dt_board {
+    rpiz_arena *arena; /* owns the strings below */
+
     char *board_model;
     char *board_serial;
 
@@ -42,6 +44,14 @@ char *get_dt_string(char *p) {
     return ret;
 }
 
+static char *get_dt_string_arena(rpiz_arena *a, char *p) {
+    char *tmp, *ret;
+    tmp = get_dt_string(p);
+    ret = arena_strdup(a, tmp);
+    free(tmp);
+    return ret;
+}
+
 int dt_board_check() {
     char *dtm;
     int ret = 0;
@@ -57,10 +67,11 @@ dt_board *dt_board_new() {
     dt_board *s = malloc( sizeof(dt_board) );
     if (s) {
         memset(s, 0, sizeof(*s));
-        s->board_model = get_dt_string("model");
-        if (!s->board_model) s->board_model = strdup("(Unknown)");
-        s->board_serial = get_dt_string("serial-number");
-        if (!s->board_serial) s->board_serial = strdup("");
+        s->arena = arena_new();
+        s->board_model = get_dt_string_arena(s->arena, "model");
+        if (!s->board_model) s->board_model = arena_strdup(s->arena, "(Unknown)");
+        s->board_serial = get_dt_string_arena(s->arena, "serial-number");
+        if (!s->board_serial) s->board_serial = arena_strdup(s->arena, "");
 
         s->fields = NULL;
     }
@@ -69,8 +80,8 @@ dt_board *dt_board_new() {
 
 void dt_board_free(dt_board *s) {
     if (s) {
-        free(s->board_model);
-        free(s->board_serial);
+        fields_detach(s->fields);
+        arena_free(s->arena);
         if (s->fields)
             fields_free(s->fields);
         free(s);
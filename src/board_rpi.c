@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "util.h"
+#include "cpuinfo.h"
 #include "board_dt.h"
 #include "board_rpi.h"
 
@@ -70,6 +71,8 @@ static struct {
 };
 
 struct rpi_board {
+    rpiz_arena *arena; /* owns board_desc, dt_model, soc, revision, serial */
+
     char *board_desc;
 
     /* from /proc/device-tree/model */
@@ -139,24 +142,27 @@ static int rpi_find_board(const char *r_code) {
 #endif
 
 #define CHECK_KV(k, v)  \
-    if (strncmp(k, key, (strlen(k) < strlen(key)) ? strlen(k) : strlen(key)) == 0) { \
-        if (b->v != NULL) free(b->v);                                                \
-        b->v = malloc(strlen(value) + 1);                                      \
-        if (b->v) strcpy(b->v, value); }
+    case k:                                \
+        b->v = arena_strndup(b->arena, value.str, value.len); \
+        break;
 
 static int rpi_get_cpuinfo_data(rpi_board *b) {
     char *cpuinfo;
-    kv_scan *kv; char *key, *value;
+    kv_scan *kv; kv_slice key, value;
 
     cpuinfo = get_file_contents(PROC_CPUINFO);
     if (!cpuinfo) return 0;
 
     kv = kv_new(cpuinfo);
     if (kv) {
-        while( kv_next(kv, &key, &value) ) {
-            CHECK_KV("Revision", revision);
-            CHECK_KV("Serial",   serial);
-            CHECK_KV("Hardware", soc);
+        while( kv_next_slice(kv, &key, &value, KV_TRIM) ) {
+            switch(cpuinfo_key_lookup(key.str, key.len)) {
+                CHECK_KV(CPUINFO_REVISION, revision);
+                CHECK_KV(CPUINFO_SERIAL,   serial);
+                CHECK_KV(CPUINFO_HARDWARE, soc);
+                default:
+                    break;
+            }
         }
     }
     kv_free(kv);
@@ -164,7 +170,7 @@ static int rpi_get_cpuinfo_data(rpi_board *b) {
     return 1;
 }
 
-static char* rpi_gen_board_name(int i) {
+static char* rpi_gen_board_name(rpiz_arena *a, int i) {
     char *ret = NULL;
     int l = 0;
 
@@ -172,17 +178,19 @@ static char* rpi_gen_board_name(int i) {
     while(rpi_boardinfo[l].value != NULL) l++;
     if (i >= l) return NULL;
 
-    ret = malloc(256);
+    ret = arena_alloc(a, 256);
     if (ret)
         snprintf(ret, 255, "Raspberry Pi %s Rev %s", rpi_boardinfo[i].model, rpi_boardinfo[i].pcb);
     return ret;
 }
 
 rpi_board *rpi_board_new() {
+    char *dtm;
     int i = 0;
     rpi_board *s = malloc( sizeof(rpi_board) );
     if (s) {
         memset(s, 0, sizeof(*s));
+        s->arena = arena_new();
         rpi_get_cpuinfo_data(s);
 
         i = rpi_find_board(s->revision);
@@ -197,9 +205,11 @@ rpi_board *rpi_board_new() {
             if (ov_check(s->revision))
                 s->overvolt = 1;
 
-        s->dt_model = get_dt_string("model");
+        dtm = get_dt_string("model");
+        s->dt_model = arena_strdup(s->arena, dtm);
+        free(dtm);
         if (i)
-            s->board_desc = rpi_gen_board_name(i);
+            s->board_desc = rpi_gen_board_name(s->arena, i);
         else {
             if (s->dt_model)
                 s->board_desc = s->dt_model;
@@ -214,12 +224,8 @@ rpi_board *rpi_board_new() {
 
 void rpi_board_free(rpi_board *s) {
     if (s) {
-        free(s->soc);
-        free(s->revision);
-        free(s->serial);
-        if (s->board_desc != s->dt_model && s->board_desc != unk)
-            free(s->board_desc);
-        free(s->dt_model);
+        fields_detach(s->fields);
+        arena_free(s->arena);
         if (s->fields)
             fields_free(s->fields);
         free(s);
@@ -292,25 +298,18 @@ int rpi_board_overvolt(rpi_board *s) {
 }
 
 float rpi_soc_temp() {
-    char *tmp = NULL;
+    char tmp[32];
     float temp = 0.0f;
-    tmp = get_file_contents("/sys/class/thermal/thermal_zone0/temp");
-    if (tmp != NULL)
+    if (get_file_contents_live("/sys/class/thermal/thermal_zone0/temp", tmp, sizeof(tmp)) > 0)
         temp = (float)atoi(tmp);
     if (temp)
         temp /= 1000.0f;
-    free(tmp);
     return temp;
 }
 
-static char* rpi_soc_temp_str(void *s) {
-    float t = rpi_soc_temp();
-    char *buff;
-    s = s; /* avoid a warning */
-    buff = malloc(128);
-    if (buff)
-        snprintf(buff, 127, "%0.2f'C", t);
-    return buff;
+static double rpi_soc_temp_num(void *s, int i) {
+    s = s; i = i; /* avoid a warning */
+    return rpi_soc_temp();
 }
 
 static char* rpi_board_overvolt_str(rpi_board *s) {
@@ -325,13 +324,14 @@ static char* rpi_board_overvolt_str(rpi_board *s) {
 
 #define ADDFIELD(t, l, o, n, f) fields_update_bytag(s->fields, t, l, o, n, (rpiz_fields_get_func)f, (void*)s)
 #define ADDFIELDSTR(t, l, o, n, str) fields_update_bytag(s->fields, t, l, o, n, NULL, (void*)str)
+#define ADDFIELDNUM(t, l, n, f, sc, d, u) fields_update_bytag_num(s->fields, t, l, n, (rpiz_fields_get_num_func)f, (void*)s, 0, sc, d, u)
 rpiz_fields *rpi_board_fields(rpi_board *s) {
     if (s) {
         if (!s->fields) {
             /* first insert creates */
             s->fields =
             ADDFIELD("summary.board_name",  0, 0, "Board Name", rpi_board_desc );
-            ADDFIELD("summary.rpi_temp",    1, 1, "SOC Temp",   rpi_soc_temp_str );
+            ADDFIELDNUM("summary.rpi_temp", 1, "SOC Temp",   rpi_soc_temp_num, 1, 2, "'C" );
             ADDFIELD("board.rpi_name",      0, 0, "Model", rpi_board_desc );
             ADDFIELD("board.rpi_intro",     0, 0, "Introduction", rpi_board_intro );
             ADDFIELD("board.rpi_mfgby",     0, 0, "Manufacturer", rpi_board_mfgby );
@@ -342,7 +342,10 @@ rpiz_fields *rpi_board_fields(rpi_board *s) {
             ADDFIELD("board.rpi_rcode",     0, 0, "RCode", rpi_board_rcode );
             ADDFIELD("board.rpi_serial",    0, 0, "Serial Number", rpi_board_serial );
             ADDFIELD("board.rpi_overvolt",  0, 1, "Overvolt", rpi_board_overvolt_str );
-            ADDFIELD("board.rpi_temp",      1, 1, "SOC Temp",   rpi_soc_temp_str );
+            ADDFIELDNUM("board.rpi_temp",   1, "SOC Temp",   rpi_soc_temp_num, 1, 2, "'C" );
+            /* the SoC warms and cools slowly */
+            fields_set_period(s->fields, "summary.rpi_temp", 2000);
+            fields_set_period(s->fields, "board.rpi_temp", 2000);
         }
         return s->fields;
     }
@@ -0,0 +1,369 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "cpu.h"
+#include "cache.h"
+
+#define CACHE_MAX_INDEX 8 /* cpuN/cache/index0..7 */
+
+typedef struct {
+    int level;
+    cache_type type;
+    int size_kb;
+    int ways;
+    int line_size;
+    char *shared; /* shared_cpu_list */
+    int shared_count;
+    int group;
+} cache_entry;
+
+struct cpu_caches {
+    cpu_topology *topo;
+    int generation; /* of topo when last read */
+
+    /* as read, CACHE_MAX_INDEX slots for each thread of topo */
+    cache_entry *slots;
+    int *slot_count;
+    int *slot_cache; /* caches[] each slot is */
+    int cpu_count;
+    int *by_cpu; /* logical cpu -> first slot, or -1 */
+    int by_cpu_size;
+
+    cache_entry *caches;
+    int count;
+    int groups;
+
+    rpiz_fields *fields;
+    int fields_generation;
+};
+
+cpu_caches *caches_new(cpu_topology *t) {
+    cpu_caches *s;
+    if (!t) return NULL;
+    s = calloc(1, sizeof(cpu_caches));
+    if (s) {
+        s->topo = t;
+        s->generation = -1;
+        s->fields_generation = -1;
+    }
+    return s;
+}
+
+static void caches_clear(cpu_caches *s) {
+    int i;
+    for (i = 0; i < s->cpu_count * CACHE_MAX_INDEX; i++)
+        free(s->slots[i].shared);
+    free(s->slots);
+    free(s->slot_count);
+    free(s->slot_cache);
+    free(s->by_cpu);
+    free(s->caches);
+    s->slots = NULL;
+    s->slot_count = s->slot_cache = s->by_cpu = NULL;
+    s->caches = NULL;
+    s->cpu_count = s->by_cpu_size = s->count = s->groups = 0;
+}
+
+void caches_free(cpu_caches *s) {
+    if (s) {
+        fields_detach(s->fields);
+        caches_clear(s);
+        fields_free(s->fields);
+        free(s);
+    }
+}
+
+/* "32K", "8M" */
+static int parse_size_kb(const char *str) {
+    char *end;
+    long v = strtol(str, &end, 10);
+    switch (*end) {
+        case 'M': v *= 1024; break;
+        case 'G': v *= 1024 * 1024; break;
+        default: break;
+    }
+    return v;
+}
+
+static cache_type parse_type(const char *str) {
+    if (strncmp(str, "Data", 4) == 0) return CACHE_DATA;
+    if (strncmp(str, "Instruction", 11) == 0) return CACHE_INSTRUCTION;
+    if (strncmp(str, "Unified", 7) == 0) return CACHE_UNIFIED;
+    return CACHE_OTHER;
+}
+
+static void read_cpu_caches(void *data, int i) {
+    cpu_caches *s = data;
+    cache_entry *e = &s->slots[i * CACHE_MAX_INDEX];
+    int cpu = topology_cpu_at(s->topo, i);
+    char item[64], buff[64], *nl;
+    int m;
+    for (m = 0; m < CACHE_MAX_INDEX; m++, e++) {
+#define INDEX_ITEM(f) (snprintf(item, sizeof(item), "cache/index%d/" f, m), item)
+        if (get_cpu_str_buf(INDEX_ITEM("level"), cpu, buff, sizeof(buff)) <= 0)
+            break;
+        e->level = atoi(buff);
+        if (get_cpu_str_buf(INDEX_ITEM("type"), cpu, buff, sizeof(buff)) > 0)
+            e->type = parse_type(buff);
+        else
+            e->type = CACHE_OTHER;
+        if (get_cpu_str_buf(INDEX_ITEM("size"), cpu, buff, sizeof(buff)) > 0)
+            e->size_kb = parse_size_kb(buff);
+        if (get_cpu_str_buf(INDEX_ITEM("ways_of_associativity"), cpu, buff, sizeof(buff)) > 0)
+            e->ways = atoi(buff);
+        if (get_cpu_str_buf(INDEX_ITEM("coherency_line_size"), cpu, buff, sizeof(buff)) > 0)
+            e->line_size = atoi(buff);
+        e->shared = get_cpu_str(INDEX_ITEM("shared_cpu_list"), cpu);
+        if (e->shared) {
+            if ((nl = strchr(e->shared, '\n')))
+                *nl = 0;
+            e->shared_count = cpulist_count(e->shared);
+        } else
+            e->shared_count = 1;
+    }
+    s->slot_count[i] = m;
+}
+
+/* alike, except for sharing */
+static int cache_kind_cmp(const cache_entry *a, const cache_entry *b) {
+    if (a->level != b->level) return (a->level < b->level) ? -1 : 1;
+    if (a->type != b->type) return (a->type < b->type) ? -1 : 1;
+    if (a->size_kb != b->size_kb) return (a->size_kb < b->size_kb) ? -1 : 1;
+    if (a->ways != b->ways) return (a->ways < b->ways) ? -1 : 1;
+    if (a->line_size != b->line_size) return (a->line_size < b->line_size) ? -1 : 1;
+    return 0;
+}
+
+static int slot_cmp(const void *a, const void *b) {
+    const cache_entry *x = *(cache_entry * const *)a, *y = *(cache_entry * const *)b;
+    int r = cache_kind_cmp(x, y);
+    if (r) return r;
+    return strcmp(x->shared ? x->shared : "", y->shared ? y->shared : "");
+}
+
+/* re-read only if the topology was rebuilt since */
+static void caches_refresh(cpu_caches *s) {
+    cache_entry **order;
+    int gen, i, m, n, cpu;
+    gen = topology_generation(s->topo);
+    if (gen == s->generation) return;
+    caches_clear(s);
+    s->generation = gen;
+    if (!topology_from_sysfs(s->topo)) return;
+
+    s->cpu_count = topology_count(s->topo, TOPO_THREAD);
+    if (!s->cpu_count) return;
+    s->slots = calloc(s->cpu_count * CACHE_MAX_INDEX, sizeof(cache_entry));
+    s->slot_count = calloc(s->cpu_count, sizeof(int));
+    s->slot_cache = calloc(s->cpu_count * CACHE_MAX_INDEX, sizeof(int));
+    if (!s->slots || !s->slot_count || !s->slot_cache) {
+        caches_clear(s);
+        return;
+    }
+    run_parallel(s->cpu_count, read_cpu_caches, s);
+
+    for (i = 0; i < s->cpu_count; i++) {
+        cpu = topology_cpu_at(s->topo, i);
+        if (cpu >= s->by_cpu_size) s->by_cpu_size = cpu + 1;
+    }
+    s->by_cpu = malloc(sizeof(int) * s->by_cpu_size);
+    order = malloc(sizeof(cache_entry*) * s->cpu_count * CACHE_MAX_INDEX);
+    s->caches = malloc(sizeof(cache_entry) * s->cpu_count * CACHE_MAX_INDEX);
+    if (!s->by_cpu || !order || !s->caches) {
+        free(order);
+        caches_clear(s);
+        return;
+    }
+    for (i = 0; i < s->by_cpu_size; i++)
+        s->by_cpu[i] = -1;
+
+    /* every cpu that shares a cache lists it, so it is
+     * the sorted slots that are the same one after another */
+    for (i = 0, n = 0; i < s->cpu_count; i++) {
+        s->by_cpu[topology_cpu_at(s->topo, i)] = i * CACHE_MAX_INDEX;
+        for (m = 0; m < s->slot_count[i]; m++)
+            order[n++] = &s->slots[i * CACHE_MAX_INDEX + m];
+    }
+    qsort(order, n, sizeof(cache_entry*), slot_cmp);
+    for (i = 0; i < n; i++) {
+        if (i == 0 || slot_cmp(&order[i - 1], &order[i]) != 0) {
+            if (i == 0 || cache_kind_cmp(order[i - 1], order[i]) != 0)
+                s->groups++;
+            s->caches[s->count] = *order[i];
+            s->caches[s->count].group = s->groups - 1;
+            s->count++;
+        }
+        s->slot_cache[order[i] - s->slots] = s->count - 1;
+    }
+    free(order);
+}
+
+int caches_count(cpu_caches *s) {
+    if (s) {
+        caches_refresh(s);
+        return s->count;
+    }
+    return 0;
+}
+
+int caches_groups(cpu_caches *s) {
+    if (s) {
+        caches_refresh(s);
+        return s->groups;
+    }
+    return 0;
+}
+
+int caches_find(cpu_caches *s, int cpu, int level, cache_type type) {
+    cache_entry *e;
+    int i, m, first;
+    if (!s) return -1;
+    caches_refresh(s);
+    if (cpu < 0 || cpu >= s->by_cpu_size || s->by_cpu[cpu] < 0)
+        return -1;
+    first = s->by_cpu[cpu];
+    i = first / CACHE_MAX_INDEX;
+    for (m = 0; m < s->slot_count[i]; m++) {
+        e = &s->slots[first + m];
+        if (e->level == level && (type == CACHE_ANY || e->type == type))
+            return s->slot_cache[first + m];
+    }
+    return -1;
+}
+
+static cache_entry *get_cache(cpu_caches *s, int cache) {
+    if (s) {
+        caches_refresh(s);
+        if (cache >= 0 && cache < s->count)
+            return &s->caches[cache];
+    }
+    return NULL;
+}
+
+#define CACHE_GETTER(type, f, none) \
+    type caches_##f(cpu_caches *s, int cache) { \
+        cache_entry *e = get_cache(s, cache); \
+        return (e) ? e->f : none; }
+CACHE_GETTER(int, level, 0)
+CACHE_GETTER(cache_type, type, CACHE_OTHER)
+CACHE_GETTER(int, size_kb, 0)
+CACHE_GETTER(int, ways, 0)
+CACHE_GETTER(int, line_size, 0)
+CACHE_GETTER(int, shared_count, 0)
+
+const char *caches_shared_cpus(cpu_caches *s, int cache) {
+    cache_entry *e = get_cache(s, cache);
+    return (e) ? e->shared : NULL;
+}
+
+int caches_group_of(cpu_caches *s, int cache) {
+    cache_entry *e = get_cache(s, cache);
+    return (e) ? e->group : -1;
+}
+
+static const char *type_name[] = {
+    [CACHE_DATA] = "Data",
+    [CACHE_INSTRUCTION] = "Instruction",
+    [CACHE_UNIFIED] = "Unified",
+    [CACHE_OTHER] = "Cache",
+};
+
+/* one each, so a level's groups of each type are numbered apart */
+static const char *type_tag[] = {
+    [CACHE_DATA] = "d",
+    [CACHE_INSTRUCTION] = "i",
+    [CACHE_UNIFIED] = "",
+    [CACHE_OTHER] = "o",
+};
+
+/* "8x 32 KB, 8-way, 64 byte lines, 2 cpus each" */
+static char *group_field(cpu_caches *s, int group) {
+    cache_entry *e = NULL;
+    char buff[256] = "";
+    int i, n = 0, each = -1, l;
+    for (i = 0; i < s->count; i++) {
+        if (s->caches[i].group != group) continue;
+        if (!e) e = &s->caches[i];
+        if (each == -1) each = s->caches[i].shared_count;
+        else if (each != s->caches[i].shared_count) each = 0;
+        n++;
+    }
+    if (!e) return strdup(buff);
+    l = snprintf(buff, 256, "%dx %d KB", n, e->size_kb);
+    if (l < 256 && e->ways)
+        l += snprintf(buff + l, 256 - l, ", %d-way", e->ways);
+    if (l < 256 && e->line_size)
+        l += snprintf(buff + l, 256 - l, ", %d byte lines", e->line_size);
+    if (l < 256 && each > 0)
+        snprintf(buff + l, 256 - l, ", %d cpu%s each", each, (each > 1) ? "s" : "");
+    return strdup(buff);
+}
+
+#define ADDFIELDAT(t, l, n, f, i) fields_update_bytag_at(s->fields, t, l, n, (rpiz_fields_get_at_func)f, (void*)s, i)
+rpiz_fields *caches_fields(cpu_caches *s) {
+    char bn[256] = "", bt[256] = "";
+    cache_entry *e, *prev;
+    rpiz_fields *nf;
+    int i, k = 0;
+    if (s) {
+        caches_refresh(s);
+        if (s->fields_generation != s->generation) {
+            fields_detach(s->fields);
+            fields_free(s->fields);
+            s->fields = NULL;
+            s->fields_generation = s->generation;
+            /* cache.l1d[0], cache.l2[0], cache.l2[1] ... one for each
+             * group, numbered where sizes differ at the same level and
+             * type. caches are sorted by level then type */
+            for (i = 0; i < s->count; i++) {
+                e = &s->caches[i];
+                prev = (i > 0) ? e - 1 : NULL;
+                if (prev && prev->group == e->group) continue;
+                k = (prev && prev->level == e->level && prev->type == e->type) ? k + 1 : 0;
+                sprintf(bt, "cache.l%d%s[%d]", e->level, type_tag[e->type], k);
+                sprintf(bn, "L%d %s", e->level, type_name[e->type]);
+                /* first insert creates */
+                nf = ADDFIELDAT(bt, 0, bn, group_field, e->group);
+                if (!s->fields) s->fields = nf;
+            }
+        }
+        return s->fields;
+    }
+    return NULL;
+}
+
+static cpu_caches *caches;
+
+int cache_init(void) {
+    caches = caches_new(cpu_topology_get());
+    return (caches != NULL);
+}
+
+void cache_cleanup(void) {
+    caches_free(caches);
+    caches = NULL;
+}
+
+rpiz_fields *cache_fields(void) {
+    return caches_fields(caches);
+}
@@ -0,0 +1,66 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "fields.h"
+#include "topology.h"
+
+/* this machine's caches, after cpu_init() */
+int cache_init(void);
+void cache_cleanup(void);
+
+rpiz_fields *cache_fields(void);
+
+/* /sys/devices/system/cpu/cpuN/cache/index* of the cpus in a
+ * topology. Each cache is listed once, however many cpus share it,
+ * and everything is re-read only after the topology is rebuilt. */
+typedef enum {
+    CACHE_ANY = -1,
+    CACHE_DATA,
+    CACHE_INSTRUCTION,
+    CACHE_UNIFIED,
+    CACHE_OTHER,
+} cache_type;
+
+typedef struct cpu_caches cpu_caches;
+
+cpu_caches *caches_new(cpu_topology *);
+void caches_free(cpu_caches *);
+
+int caches_count(cpu_caches *);
+/* the cache cpu uses at level, -1 if none */
+int caches_find(cpu_caches *, int cpu, int level, cache_type type);
+
+int caches_level(cpu_caches *, int cache);
+cache_type caches_type(cpu_caches *, int cache);
+int caches_size_kb(cpu_caches *, int cache);
+int caches_ways(cpu_caches *, int cache);
+int caches_line_size(cpu_caches *, int cache);
+const char *caches_shared_cpus(cpu_caches *, int cache); /* cpu list */
+int caches_shared_count(cpu_caches *, int cache);
+
+/* caches alike in all but which cpus share them are one group */
+int caches_groups(cpu_caches *);
+int caches_group_of(cpu_caches *, int cache);
+
+rpiz_fields *caches_fields(cpu_caches *);
+
+#endif
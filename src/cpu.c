@@ -20,6 +20,8 @@
 
 #include <stdlib.h>
 #include "cpu.h"
+#include "cpuinfo.h"
+#include "util.h"
 #include "cpu_arm.h"
 #include "arm_data.h"
 #include "cpu_x86.h"
@@ -27,6 +29,10 @@
 #include "cpu_riscv.h"
 #include "riscv_data.h"
 
+#ifndef PROC_CPUINFO
+#define PROC_CPUINFO "/proc/cpuinfo"
+#endif
+
 typedef enum {
     PT_UNKNOWN = 0,
     PT_ARM,
@@ -35,101 +41,264 @@ typedef enum {
     PT_N_TYPES,
 } cpu_type;
 
-struct {
-    cpu_type type;
-    union {
-        arm_proc *arm;
-        x86_proc *x86;
-        riscv_proc *riscv;
-    };
-} cpu;
+/* every backend is built, a cpu_proc points at the one for its cpuinfo */
+typedef void *(*cpu_new_func)(const char *path);
+typedef void (*cpu_free_func)(void *);
+typedef int (*cpu_has_flag_func)(void *, const char *flag);
+typedef const char *(*cpu_str_func)(void *);
+typedef const char *(*cpu_meaning_func)(const char *flag);
+typedef int (*cpu_update_func)(void *);
+typedef rpiz_fields *(*cpu_fields_func)(void *);
+typedef cpu_topology *(*cpu_topology_func)(void *);
+typedef int (*cpu_count_func)(void *);
+typedef int (*cpu_core_int_func)(void *, int core);
 
-int cpu_init() {
-    cpu.type = PT_UNKNOWN;
+typedef struct {
+    const char *arch;
+    cpu_new_func new_file;
+    cpu_free_func free;
+    cpu_str_func all_flags;
+    cpu_has_flag_func has_flag;
+    cpu_str_func uncommon_flags;
+    cpu_meaning_func flag_meaning;
+    cpu_update_func update;
+    cpu_fields_func fields;
+    cpu_topology_func topology;
+    /* cores, or x86 threads, with their clocks */
+    cpu_count_func cores;
+    cpu_core_int_func core_id;
+    cpu_core_int_func khz_min, khz_max, khz_cur;
+    cpu_count_func freq_sample;
+} cpu_backend;
+
+static const cpu_backend backends[PT_N_TYPES] = {
+    [PT_ARM] = { "arm",
+        (cpu_new_func)arm_proc_new_file, (cpu_free_func)arm_proc_free,
+        (cpu_str_func)arm_proc_all_flags, (cpu_has_flag_func)arm_proc_has_flag,
+        (cpu_str_func)arm_proc_uncommon_flags, arm_flag_meaning,
+        (cpu_update_func)arm_proc_update, (cpu_fields_func)arm_proc_fields,
+        (cpu_topology_func)arm_proc_topology,
+        (cpu_count_func)arm_proc_cores, (cpu_core_int_func)arm_proc_core_id,
+        (cpu_core_int_func)arm_proc_core_khz_min, (cpu_core_int_func)arm_proc_core_khz_max,
+        (cpu_core_int_func)arm_proc_core_khz_cur, (cpu_count_func)arm_proc_freq_sample },
+    [PT_X86] = { "x86",
+        (cpu_new_func)x86_proc_new_file, (cpu_free_func)x86_proc_free,
+        (cpu_str_func)x86_proc_all_flags, (cpu_has_flag_func)x86_proc_has_flag,
+        (cpu_str_func)x86_proc_uncommon_flags, x86_flag_meaning,
+        (cpu_update_func)x86_proc_update, (cpu_fields_func)x86_proc_fields,
+        (cpu_topology_func)x86_proc_topology,
+        (cpu_count_func)x86_proc_threads, (cpu_core_int_func)x86_proc_thread_id,
+        (cpu_core_int_func)x86_proc_thread_khz_min, (cpu_core_int_func)x86_proc_thread_khz_max,
+        (cpu_core_int_func)x86_proc_thread_khz_cur, (cpu_count_func)x86_proc_freq_sample },
+    [PT_RISCV] = { "riscv",
+        (cpu_new_func)riscv_proc_new_file, (cpu_free_func)riscv_proc_free,
+        (cpu_str_func)riscv_proc_all_flags, (cpu_has_flag_func)riscv_proc_has_flag,
+        (cpu_str_func)riscv_proc_uncommon_flags, riscv_ext_meaning,
+        (cpu_update_func)riscv_proc_update, (cpu_fields_func)riscv_proc_fields,
+        (cpu_topology_func)riscv_proc_topology,
+        (cpu_count_func)riscv_proc_cores, (cpu_core_int_func)riscv_proc_core_id,
+        (cpu_core_int_func)riscv_proc_core_khz_min, (cpu_core_int_func)riscv_proc_core_khz_max,
+        (cpu_core_int_func)riscv_proc_core_khz_cur, (cpu_count_func)riscv_proc_freq_sample },
+};
+
+struct cpu_proc {
+    const cpu_backend *be;
+    void *p;
+};
+
+static cpu_proc *cpu;
+
+/* the first key only one backend's cpuinfo has decides */
+static cpu_type sniff_cpuinfo(const char *path) {
+    kv_scan *kv; kv_slice key, value;
+    cpu_type type = PT_UNKNOWN;
+
+    kv = kv_new_file(path);
+    if (!kv) return PT_UNKNOWN;
+    while( type == PT_UNKNOWN && kv_next_slice(kv, &key, &value, KV_TRIM) ) {
+        switch(cpuinfo_key_lookup(key.str, key.len)) {
+            case CPUINFO_CPU_IMPLEMENTER:
+            case CPUINFO_CPU_ARCHITECTURE:
+            case CPUINFO_CPU_PART:
+            case CPUINFO_FEATURES:
+                type = PT_ARM;
+                break;
+            case CPUINFO_VENDOR_ID:
+                type = PT_X86;
+                break;
+            case CPUINFO_ISA:
+            case CPUINFO_HART:
+                type = PT_RISCV;
+                break;
+            default:
+                break;
+        }
+    }
+    kv_free(kv);
+    return type;
+}
 
+/* if the cpuinfo doesn't say, assume it is what this was built for */
+static cpu_type host_type(void) {
 #if defined(__arm__) || defined(__aarch64__)
-    cpu.arm = arm_proc_new();
-    cpu.type = PT_ARM;
+    return PT_ARM;
+#elif defined(__i386__) || defined(__x86_64__)
+    return PT_X86;
+#elif defined(__riscv)
+    return PT_RISCV;
+#else
+    return PT_UNKNOWN;
 #endif
+}
 
-#if defined(__i386__) || defined(__x86_64__)
-    cpu.x86 = x86_proc_new();
-    cpu.type = PT_X86;
-#endif
+static cpu_proc *cpu_proc_new_type(cpu_type type, const char *path) {
+    cpu_proc *s;
+    if (type == PT_UNKNOWN) return NULL;
+    s = malloc( sizeof(cpu_proc) );
+    if (s) {
+        s->be = &backends[type];
+        s->p = s->be->new_file(path);
+        if (!s->p) {
+            free(s);
+            return NULL;
+        }
+    }
+    return s;
+}
 
-#if defined(__riscv32__) || defined(__riscv64__)
-    cpu.riscv = riscv_proc_new();
-    cpu.type = PT_RISCV;
-#endif
+cpu_proc *cpu_proc_new_file(const char *path) {
+    if (!path) return NULL;
+    return cpu_proc_new_type(sniff_cpuinfo(path), path);
+}
+
+void cpu_proc_free(cpu_proc *s) {
+    if (s) {
+        s->be->free(s->p);
+        free(s);
+    }
+}
 
+const char *cpu_proc_arch(cpu_proc *s) {
+    return (s) ? s->be->arch : NULL;
+}
+
+const char *cpu_proc_all_flags(cpu_proc *s) {
+    return (s) ? s->be->all_flags(s->p) : NULL;
+}
+
+int cpu_proc_has_flag(cpu_proc *s, const char *flag) {
+    return (s) ? s->be->has_flag(s->p, flag) : 0;
+}
+
+const char *cpu_proc_uncommon_flags(cpu_proc *s) {
+    return (s) ? s->be->uncommon_flags(s->p) : NULL;
+}
+
+const char *cpu_proc_flag_meaning(cpu_proc *s, const char *flag) {
+    return (s) ? s->be->flag_meaning(flag) : NULL;
+}
+
+int cpu_proc_update(cpu_proc *s) {
+    return (s) ? s->be->update(s->p) : 0;
+}
+
+rpiz_fields *cpu_proc_fields(cpu_proc *s) {
+    return (s) ? s->be->fields(s->p) : NULL;
+}
+
+cpu_topology *cpu_proc_topology(cpu_proc *s) {
+    return (s) ? s->be->topology(s->p) : NULL;
+}
+
+int cpu_proc_cores(cpu_proc *s) {
+    return (s) ? s->be->cores(s->p) : 0;
+}
+
+int cpu_proc_core_id(cpu_proc *s, int core) {
+    return (s) ? s->be->core_id(s->p, core) : -1;
+}
+
+int cpu_proc_core_khz_min(cpu_proc *s, int core) {
+    return (s) ? s->be->khz_min(s->p, core) : 0;
+}
+
+int cpu_proc_core_khz_max(cpu_proc *s, int core) {
+    return (s) ? s->be->khz_max(s->p, core) : 0;
+}
+
+int cpu_proc_core_khz_cur(cpu_proc *s, int core) {
+    return (s) ? s->be->khz_cur(s->p, core) : 0;
+}
+
+int cpu_proc_freq_sample(cpu_proc *s) {
+    return (s) ? s->be->freq_sample(s->p) : 0;
+}
+
+int cpu_init() {
+    cpu_type type = sniff_cpuinfo(PROC_CPUINFO);
+    if (type == PT_UNKNOWN)
+        type = host_type();
+    cpu = cpu_proc_new_type(type, PROC_CPUINFO);
     return 1;
 }
 
 void cpu_cleanup() {
-    switch (cpu.type) {
-        case (PT_ARM):
-            if (cpu.arm) arm_proc_free(cpu.arm);
-            break;
-        case (PT_X86):
-            if (cpu.x86) x86_proc_free(cpu.x86);
-            break;
-        case (PT_RISCV):
-            if (cpu.riscv) riscv_proc_free(cpu.riscv);
-            break;
-        default:
-            break;
-    }
+    cpu_proc_free(cpu);
+    cpu = NULL;
+}
+
+const char *cpu_arch(void) {
+    return cpu_proc_arch(cpu);
 }
 
 const char *cpu_all_flags(void) {
-    switch (cpu.type) {
-        case (PT_ARM):
-            return arm_flag_list();
-        case (PT_X86):
-            return x86_flag_list();
-        case (PT_RISCV):
-            return riscv_ext_list();
-        default:
-            return NULL;
-    }
+    return cpu_proc_all_flags(cpu);
 }
 
 int cpu_has_flag(const char *flag) {
-    switch (cpu.type) {
-        case (PT_ARM):
-            return arm_proc_has_flag(cpu.arm, flag);
-        case (PT_X86):
-            return x86_proc_has_flag(cpu.x86, flag);
-        case (PT_RISCV):
-            return riscv_proc_has_flag(cpu.riscv, flag);
-        default:
-            return 0;
-    }
+    return cpu_proc_has_flag(cpu, flag);
+}
+
+const char *cpu_uncommon_flags(void) {
+    return cpu_proc_uncommon_flags(cpu);
+}
+
+int cpu_update(void) {
+    return cpu_proc_update(cpu);
 }
 
 const char *cpu_flag_meaning(const char *flag) {
-    switch (cpu.type) {
-        case (PT_ARM):
-            return arm_flag_meaning(flag);
-        case (PT_X86):
-            return x86_flag_meaning(flag);
-        case (PT_RISCV):
-            return riscv_ext_meaning(flag);
-        default:
-            return NULL;
-    }
+    return cpu_proc_flag_meaning(cpu, flag);
+}
+
+cpu_topology *cpu_topology_get(void) {
+    return cpu_proc_topology(cpu);
+}
+
+int cpu_cores(void) {
+    return cpu_proc_cores(cpu);
+}
+
+int cpu_core_id(int core) {
+    return cpu_proc_core_id(cpu, core);
+}
+
+int cpu_core_khz_min(int core) {
+    return cpu_proc_core_khz_min(cpu, core);
+}
+
+int cpu_core_khz_max(int core) {
+    return cpu_proc_core_khz_max(cpu, core);
+}
+
+int cpu_core_khz_cur(int core) {
+    return cpu_proc_core_khz_cur(cpu, core);
+}
+
+int cpu_freq_sample(void) {
+    return cpu_proc_freq_sample(cpu);
 }
 
 rpiz_fields *cpu_fields() {
-    switch (cpu.type) {
-        case (PT_ARM):
-            return arm_proc_fields(cpu.arm);
-        case (PT_X86):
-            return x86_proc_fields(cpu.x86);
-        case (PT_RISCV):
-            return riscv_proc_fields(cpu.riscv);
-        default:
-            return NULL;
-    }
-    return NULL;
+    return cpu_proc_fields(cpu);
 }
@@ -22,14 +22,52 @@
 #define _CPU_H_
 
 #include "fields.h"
+#include "topology.h"
 
+/* this machine */
 int cpu_init(void);
 void cpu_cleanup(void);
 
+const char *cpu_arch(void); /* "arm", "x86", "riscv" or NULL */
 const char *cpu_all_flags(void);
 int cpu_has_flag(const char *flag); /* returns core count with flag */
+const char *cpu_uncommon_flags(void); /* flags not on every core */
 const char *cpu_flag_meaning(const char *flag);
+int cpu_update(void); /* after cpu hotplug, 1 if anything changed;
+                         * the flag strings above are remade by it */
+cpu_topology *cpu_topology_get(void); /* of the online cpus */
+/* each core, or x86 thread, including those gone offline */
+int cpu_cores(void);
+int cpu_core_id(int core);
+int cpu_core_khz_min(int core);
+int cpu_core_khz_max(int core);
+int cpu_core_khz_cur(int core); /* from the last cpu_freq_sample() */
+int cpu_freq_sample(void);
 
 rpiz_fields *cpu_fields(void);
 
+/* any machine's cpuinfo, the backend is picked by the keys found.
+ * Each thread can read its own cpu_procs at the same time as the
+ * others; one cpu_proc, and its fields, is for one thread at a time.
+ * The functions above share one cpu_proc for this machine */
+typedef struct cpu_proc cpu_proc;
+
+cpu_proc *cpu_proc_new_file(const char *path);
+void cpu_proc_free(cpu_proc *);
+
+const char *cpu_proc_arch(cpu_proc *);
+const char *cpu_proc_all_flags(cpu_proc *);
+int cpu_proc_has_flag(cpu_proc *, const char *flag);
+const char *cpu_proc_uncommon_flags(cpu_proc *);
+const char *cpu_proc_flag_meaning(cpu_proc *, const char *flag);
+int cpu_proc_update(cpu_proc *);
+rpiz_fields *cpu_proc_fields(cpu_proc *);
+cpu_topology *cpu_proc_topology(cpu_proc *);
+int cpu_proc_cores(cpu_proc *); /* cores, or x86 threads */
+int cpu_proc_core_id(cpu_proc *, int core);
+int cpu_proc_core_khz_min(cpu_proc *, int core);
+int cpu_proc_core_khz_max(cpu_proc *, int core);
+int cpu_proc_core_khz_cur(cpu_proc *, int core);
+int cpu_proc_freq_sample(cpu_proc *);
+
 #endif
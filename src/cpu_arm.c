@@ -22,32 +22,12 @@
 #include <stdio.h>
 #include <string.h>
 #include "util.h"
+#include "cpuinfo.h"
 #include "cpu_arm.h"
 
-#define MAX_CORES 128
-
-static int search_for_flag(char *flags, const char *flag) {
-    char *p = strstr(flags, flag);
-    int l = strlen(flag);
-    int front = 0, back = 0;
-    //DEBUG printf("search_for_flag( %x, \"%s\")\n", flags, flag);
-    if (strlen(flag) == 0 || strchr(flag, ' ') )
-        return 0;
-    while (p) {
-        if (p == flags) front = 1;
-        else if (*(p - 1) == ' ') front = 1;
-        if (*(p + l) == ' ' || *(p + l) == '\0')
-            back = 1;
-        if (front && back)
-            return 1;
-        p = strstr(p + l, flag);
-    }
-    return 0;
-}
 
 typedef struct {
     int id;
-    int cpukhz_min, cpukhz_max, cpukhz_cur;
 
     unsigned long long reg_midr_el1;
     unsigned long long reg_revidr_el1;
@@ -62,9 +42,14 @@ typedef struct {
     char *cpu_revision;
     char *decoded_name;
     char *cpukhz_max_str;
+
+    int online; /* offline cores are kept, but not counted */
 } arm_core;
 
 struct arm_proc {
+    rpiz_arena *arena; /* owns the strings below */
+    rpiz_arena *derived; /* cpu_desc, all_flags and flag_sets, made again by each update */
+
     cpu_string_list *model_name;
     cpu_string_list *decoded_name;
     cpu_string_list *flags;
@@ -75,19 +60,32 @@ struct arm_proc {
     cpu_string_list *cpu_revision;
     cpu_string_list *cpukhz_max_str;
 
+    /* the known flags from arm_data.c come first, in table order,
+     * followed by any others found. ref_count is cores with flag */
     cpu_string_list *each_flag;
+    char *all_flags; /* each_flag joined, built when first asked for */
+    cpu_flag_sets flag_sets; /* over each_flag, per core */
 
     char cpu_name[256];
     char *cpu_desc;
     int max_khz;
+    cpufreq_sampler *freq;
     int core_count;
-    arm_core cores[MAX_CORES];
+    arm_core *cores;
+    int core_alloc;
+    int *decoded_from; /* a core of each kind, see core_decoded_name() */
+    int decoded_count, decoded_alloc;
+    cpu_topology *topo; /* of online cores */
+
+    const char *path; /* the cpuinfo read */
+    int host; /* path is this machine's, so sysfs applies */
+    char *online; /* /sys/devices/system/cpu/online as of the last update */
+    int generation;
 
     rpiz_fields *fields;
 };
 
-#define CHECK_FOR(k) (strncmp(k, key, (strlen(k) < strlen(key)) ? strlen(k) : strlen(key)) == 0)
-#define GET_STR(k, s) if (CHECK_FOR(k)) { p->cores[core].s = strlist_add(p->s, value); continue; }
+#define GET_STR(k, s) case k: p->cores[core].s = strlist_add_n(p->s, value.str, value.len); break;
 #define FIN_PROC() if (core >= 0) if (!p->cores[core].model_name) { p->cores[core].model_name = strlist_add(p->model_name, rep_pname); }
 
 #define REDUP(f) if(p->cores[di].f && !p->cores[i].f) { p->cores[i].f = strlist_add(p->f, p->cores[di].f); }
@@ -96,62 +94,148 @@ struct arm_proc {
 #define PROC_CPUINFO "/proc/cpuinfo"
 #endif
 
-static int scan_cpu(arm_proc* p) {
-    kv_scan *kv; char *key, *value;
-    int core = -1;
+/* grow cores[] to hold at least n, doubling */
+static int reserve_cores(arm_proc *p, int n) {
+    arm_core *tmp;
+    int na;
+    if (n <= p->core_alloc) return 1;
+    na = (p->core_alloc) ? p->core_alloc * 2 : 8;
+    while (na < n) na *= 2;
+    tmp = realloc(p->cores, sizeof(arm_core) * na);
+    if (!tmp) return 0;
+    p->cores = tmp;
+    p->core_alloc = na;
+    return 1;
+}
+
+typedef struct {
+    arm_proc *p;
+    int first;
+} enrich_data;
+
+static void enrich_core(void *data, int i) {
+    enrich_data *e = data;
+    arm_core *c = &e->p->cores[e->first + i];
+    char tmp_reg[32] = "";
+
+    /* id registers (aarch64) */
+    if (get_cpu_str_buf("regs/identification/midr_el1", c->id, tmp_reg, sizeof(tmp_reg)) > 0)
+        c->reg_midr_el1 = strtoll(tmp_reg, NULL, 0);
+    if (get_cpu_str_buf("regs/identification/revidr_el1", c->id, tmp_reg, sizeof(tmp_reg)) > 0)
+        c->reg_revidr_el1 = strtoll(tmp_reg, NULL, 0);
+}
+
+#define SAME_ID(a, b) ((a)->cpu_implementer == (b)->cpu_implementer && (a)->cpu_part == (b)->cpu_part \
+    && (a)->cpu_variant == (b)->cpu_variant && (a)->cpu_revision == (b)->cpu_revision \
+    && (a)->cpu_architecture == (b)->cpu_architecture && (a)->model_name == (b)->model_name)
+/* the id fields are interned, so cores with the same pointers have the
+ * same decoded name. only the first core of each kind is decoded. */
+static char *core_decoded_name(arm_proc *p, int i) {
+    arm_core *c = &p->cores[i];
+    char *dn, *ret;
+    int j, *tmp;
+
+    for (j = 0; j < p->decoded_count; j++)
+        if (SAME_ID(&p->cores[p->decoded_from[j]], c))
+            return strlist_add(p->decoded_name, p->cores[p->decoded_from[j]].decoded_name);
+
+    dn = arm_decoded_name(
+            c->cpu_implementer, c->cpu_part,
+            c->cpu_variant, c->cpu_revision,
+            c->cpu_architecture, c->model_name);
+    ret = strlist_add(p->decoded_name, dn);
+    free(dn);
+
+    if (p->decoded_count == p->decoded_alloc) {
+        tmp = realloc(p->decoded_from, sizeof(int) * (p->decoded_alloc + 8));
+        if (!tmp) return ret;
+        p->decoded_from = tmp;
+        p->decoded_alloc += 8;
+    }
+    p->decoded_from[p->decoded_count++] = i;
+    return ret;
+}
+
+/* if only is given, just the cores in that cpu list that aren't
+ * already known are read, and added after the known ones */
+static int scan_cpu(arm_proc* p, const char *only) {
+    kv_scan *kv; kv_slice key, value;
+    cpuinfo_key ck;
+    int core, first;
+    int skip = (only != NULL);
     int i, di;
     char rep_pname[256] = "";
     char tmp_maxfreq[128] = "";
-    char *tmp_dn = NULL;
-    char *tmp_reg = NULL;
+    enrich_data enrich;
 
     if (!p) return 0;
+    first = p->core_count;
+    core = first - 1;
 
-    kv = kv_new_file(PROC_CPUINFO);
+    kv = kv_new_file(p->path);
     if (kv) {
-        while( kv_next(kv, &key, &value) ) {
-            if (CHECK_FOR("Processor")) {
-                strcpy(rep_pname, value);
-                continue;
-            }
-
-            if (CHECK_FOR("Hardware")) {
-                strcpy(p->cpu_name, value);
-                continue;
-            }
-
-            if (CHECK_FOR("processor")) {
-                FIN_PROC();
-                core++;
-                memset(&p->cores[core], 0, sizeof(arm_core));
-                p->cores[core].id = atoi(value);
-                continue;
-            }
-
-            if (core < 0) {
-                if ( CHECK_FOR("model name")
-                     || CHECK_FOR("Features")
-                     || CHECK_FOR("flags") ) {
-                    /* this cpuinfo doesn't provide processor : n
-                     * there is prolly only one core */
+        while( kv_next_slice(kv, &key, &value, KV_TRIM) ) {
+            ck = cpuinfo_key_lookup(key.str, key.len);
+            switch(ck) {
+                case CPUINFO_UNKNOWN:
+                    continue;
+                case CPUINFO_PROCESSOR_NAME:
+                    kv_slice_copy(&value, rep_pname, sizeof(rep_pname));
+                    continue;
+                case CPUINFO_HARDWARE:
+                    kv_slice_copy(&value, p->cpu_name, sizeof(p->cpu_name));
+                    continue;
+                case CPUINFO_PROCESSOR:
+                    FIN_PROC();
+                    if (only) {
+                        i = atoi(value.str);
+                        skip = !cpulist_has(only, i) || arm_proc_core_from_id(p, i) >= 0;
+                        if (skip) continue;
+                    }
                     core++;
+                    if (!reserve_cores(p, core + 1)) {
+                        kv_free(kv);
+                        return 0;
+                    }
                     memset(&p->cores[core], 0, sizeof(arm_core));
-                    p->cores[core].id = 0;
-                }
+                    p->cores[core].id = atoi(value.str);
+                    p->cores[core].online = 1;
+                    continue;
+                case CPUINFO_MODEL_NAME:
+                case CPUINFO_FEATURES:
+                case CPUINFO_FLAGS:
+                    if (core < 0) {
+                        /* this cpuinfo doesn't provide processor : n
+                         * there is prolly only one core */
+                        core++;
+                        if (!reserve_cores(p, core + 1)) {
+                            kv_free(kv);
+                            return 0;
+                        }
+                        memset(&p->cores[core], 0, sizeof(arm_core));
+                        p->cores[core].id = 0;
+                        p->cores[core].online = 1;
+                    }
+                    break;
+                default:
+                    break;
             }
-            if (core >= 0) {
-                GET_STR("model name", model_name);
+            if (core < 0 || skip) continue;
+            switch(ck) {
+                GET_STR(CPUINFO_MODEL_NAME, model_name);
 
                 /* likely one or the other */
-                GET_STR("Features", flags);
-                GET_STR("flags", flags);
+                GET_STR(CPUINFO_FEATURES, flags);
+                GET_STR(CPUINFO_FLAGS, flags);
 
                 /* ARM */
-                GET_STR("CPU implementer", cpu_implementer);
-                GET_STR("CPU architecture", cpu_architecture);
-                GET_STR("CPU variant", cpu_variant);
-                GET_STR("CPU part", cpu_part);
-                GET_STR("CPU revision", cpu_revision);
+                GET_STR(CPUINFO_CPU_IMPLEMENTER, cpu_implementer);
+                GET_STR(CPUINFO_CPU_ARCHITECTURE, cpu_architecture);
+                GET_STR(CPUINFO_CPU_VARIANT, cpu_variant);
+                GET_STR(CPUINFO_CPU_PART, cpu_part);
+                GET_STR(CPUINFO_CPU_REVISION, cpu_revision);
+                default:
+                    break;
             }
         }
         FIN_PROC();
@@ -163,7 +247,7 @@ static int scan_cpu(arm_proc* p) {
 
     /* re-duplicate missing data for /proc/cpuinfo variant that de-duplicated it */
     di = p->core_count - 1;
-    for (i = di; i >= 0; i--) {
+    for (i = di; i >= first; i--) {
         if (p->cores[i].flags)
             di = i;
         else {
@@ -176,126 +260,187 @@ static int scan_cpu(arm_proc* p) {
         }
     }
 
-    /* data not from /proc/cpuinfo */
-    for (i = 0; i < p->core_count; i++) {
-        /* id registers (aarch64) */
-        tmp_reg = get_cpu_str("regs/identification/midr_el1", p->cores[i].id);
-        if (tmp_reg) p->cores[i].reg_midr_el1 = strtoll(tmp_reg, NULL, 0);
-        free(tmp_reg);
-        tmp_reg = get_cpu_str("regs/identification/revidr_el1", p->cores[i].id);
-        if (tmp_reg) p->cores[i].reg_revidr_el1 = strtoll(tmp_reg, NULL, 0);
-        free(tmp_reg);
-
+    /* cpufreq, one sampler for all cores */
+    p->freq = cpufreq_sampler_grow(p->freq, p->core_count);
+    if (!p->freq)
+        return 0;
+    for (i = first; i < p->core_count; i++)
+        p->freq->id[i] = p->cores[i].id;
+    if (p->host)
+        cpufreq_read_limits_from(p->freq, first);
+
+    /* data not from /proc/cpuinfo, read by workers */
+    enrich.p = p;
+    enrich.first = first;
+    if (p->host)
+        run_parallel(p->core_count - first, enrich_core, &enrich);
+
+    /* interning is not thread-safe, so finish here */
+    for (i = first; i < p->core_count; i++) {
         /* decoded names */
-        tmp_dn = arm_decoded_name(
-                p->cores[i].cpu_implementer, p->cores[i].cpu_part,
-                p->cores[i].cpu_variant, p->cores[i].cpu_revision,
-                p->cores[i].cpu_architecture, p->cores[i].model_name);
-        p->cores[i].decoded_name = strlist_add(p->decoded_name, tmp_dn);
-        free(tmp_dn); tmp_dn = NULL;
+        p->cores[i].decoded_name = core_decoded_name(p, i);
 
         /* freq */
-        get_cpu_freq(p->cores[i].id, &p->cores[i].cpukhz_min, &p->cores[i].cpukhz_max, &p->cores[i].cpukhz_cur);
-        sprintf(tmp_maxfreq, "%d", p->cores[i].cpukhz_max);
+        sprintf(tmp_maxfreq, "%d", p->freq->khz_max[i]);
         p->cores[i].cpukhz_max_str = strlist_add(p->cpukhz_max_str, tmp_maxfreq);
-        if (p->cores[i].cpukhz_max > p->max_khz)
-            p->max_khz = p->cores[i].cpukhz_max;
+        if (p->freq->khz_max[i] > p->max_khz)
+            p->max_khz = p->freq->khz_max[i];
     }
 
     return 1;
 }
 
+/* cpuinfo has no topology on arm, so without sysfs
+ * every core is its own, in one package */
+static void build_topology(arm_proc *p) {
+    int i;
+    if (!p->topo)
+        p->topo = topology_new();
+    topology_clear(p->topo);
+    for (i = 0; i < p->core_count; i++)
+        if (p->cores[i].online)
+            topology_add_cpu(p->topo, p->cores[i].id, -1, -1);
+    topology_build(p->topo, p->host);
+}
+
+/* entries with no online cores left are skipped */
 static char *gen_cpu_desc(arm_proc *p) {
-    char *ret = NULL;
+    char ret[4096] = "";
     char tmp[1024];
-    int i, l = 0;
+    int i, n, l = 0;
     float maxfreq;
     if (p) {
-        ret = malloc(4096);
-        memset(ret, 0, 4096);
-        for (i = 0; i < p->decoded_name->count; i++) {
+        for (i = 0, n = 0; i < p->decoded_name->count; i++) {
+            if (p->decoded_name->strs[i].ref_count <= 0) continue;
             sprintf(tmp, "%dx %s", p->decoded_name->strs[i].ref_count, p->decoded_name->strs[i].str);
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
         sprintf(ret + l, "; "); l += 2;
-        for (i = 0; i < p->cpukhz_max_str->count; i++) {
+        for (i = 0, n = 0; i < p->cpukhz_max_str->count; i++) {
+            if (p->cpukhz_max_str->strs[i].ref_count <= 0) continue;
             maxfreq = atof(p->cpukhz_max_str->strs[i].str);
             if (maxfreq)
                 maxfreq /= 1000;
             else
                 maxfreq = 0.0f;
             sprintf(tmp, "%dx %0.2f MHz", p->cpukhz_max_str->strs[i].ref_count, maxfreq);
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
     }
-    return ret;
+    return (p) ? arena_strdup(p->derived, ret) : NULL;
+}
+
+/* add weight to each flag of a flags string. each_flag is the set
+ * of known flags, returns how many weren't in it */
+static int add_flags(arm_proc *s, const char *flags, int weight) {
+    const char *w;
+    int len, before;
+    if (!s || !flags) return 0;
+
+    before = s->each_flag->count;
+    while ((len = str_next_word(&flags, &w)))
+        if (len <= 15)
+            strlist_add_wn(s->each_flag, w, len, weight);
+    if (s->each_flag->count != before)
+        s->all_flags = NULL;
+    return s->each_flag->count - before;
 }
 
-#define APPEND_FLAG(f) strcat(all_flags, f); strcat(all_flags, " ");
 static void process_flags(arm_proc *s) {
-    char flag[16] = "";
-    char *all_flags; /* arm_data.c: static char all_flags[1024] */
-    char *cur, *next;
+    const char *name;
     int added_count = 0, i;
     if (!s) return;
 
-    all_flags = (char*)arm_flag_list();
-    for(i = 0; i < s->flags->count; i++) {
-        if (s->flags->strs[i].str) {
-            cur = s->flags->strs[i].str;
-            next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-            while(next) {
-                if (next-cur <= 15) {
-                    memset(flag, 0, 16);
-                    strncpy(flag, cur, next-cur);
-                    if (strlen(flag) > 0) {
-                        /* add it to the string list, copy the flag string's ref_count */
-                        strlist_add_w(s->each_flag, flag, s->flags->strs[i].ref_count);
-
-                        /* add it to the list of known all flags, if it isn't there */
-                        if (!search_for_flag(all_flags, flag)) {
-                            APPEND_FLAG(flag);
-                            added_count++;
-                        }
-                    }
-                }
-                if (*next == '\0') break;
-                cur = next + 1;
-                next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-            }
-        }
-    }
+    for (i = 0; (name = arm_flag_name(i)); i++)
+        strlist_add_w(s->each_flag, name, 0);
+
+    for(i = 0; i < s->flags->count; i++)
+        added_count += add_flags(s, s->flags->strs[i].str, s->flags->strs[i].ref_count);
     // DEBUG printf("add_unknown_flags(): added %d previously unknown flags\n", added_count);
 }
 
+#define REWEIGHT(f) if (c->f) strlist_add_w(s->f, c->f, weight);
+/* add weight to the ref_count of everything core i points at */
+static void core_weight(arm_proc *s, int i, int weight) {
+    arm_core *c = &s->cores[i];
+    REWEIGHT(model_name);
+    REWEIGHT(flags);
+    REWEIGHT(cpu_implementer);
+    REWEIGHT(cpu_architecture);
+    REWEIGHT(cpu_variant);
+    REWEIGHT(cpu_part);
+    REWEIGHT(cpu_revision);
+    REWEIGHT(decoded_name);
+    REWEIGHT(cpukhz_max_str);
+    add_flags(s, c->flags, weight);
+}
+
+/* each core's flags as a set over each_flag,
+ * cores with the same flags string share one */
+static void build_flag_sets(arm_proc *s) {
+    const char **flags;
+    uint64_t *online;
+    int i;
+    if (!s) return;
+
+    flags = arena_alloc(s->derived, sizeof(char*) * (s->core_count + 1));
+    online = flagset_new(s->derived, FLAGSET_WORDS(s->core_count));
+    if (!flags || !online) return;
+    for (i = 0; i < s->core_count; i++) {
+        flags[i] = s->cores[i].flags;
+        if (s->cores[i].online)
+            flagset_set(online, i);
+    }
+    flag_sets_build(&s->flag_sets, s->derived, s->core_count, flags, NULL, 1, online, s->each_flag);
+}
+
 arm_proc *arm_proc_new(void) {
-    arm_proc *s = malloc( sizeof(arm_proc) );
+    return arm_proc_new_file(PROC_CPUINFO);
+}
+
+/* a cpuinfo dump from any machine, sysfs is only read
+ * when it is this machine's own cpuinfo */
+arm_proc *arm_proc_new_file(const char *path) {
+    arm_proc *s;
+    if (!path) return NULL;
+    s = malloc( sizeof(arm_proc) );
     if (s) {
         memset(s, 0, sizeof(*s));
-        s->model_name = strlist_new();
-        s->flags = strlist_new();
-        s->cpu_implementer = strlist_new();
-        s->cpu_architecture = strlist_new();
-        s->cpu_variant = strlist_new();
-        s->cpu_part = strlist_new();
-        s->cpu_revision = strlist_new();
-        s->decoded_name = strlist_new();
-        s->cpukhz_max_str = strlist_new();
-        s->each_flag = strlist_new();
-        if (!scan_cpu(s)) {
+        s->arena = arena_new();
+        s->derived = arena_new();
+        s->path = arena_strdup(s->arena, path);
+        s->host = (strcmp(path, PROC_CPUINFO) == 0);
+        s->model_name = strlist_new_arena(s->arena);
+        s->flags = strlist_new_arena(s->arena);
+        s->cpu_implementer = strlist_new_arena(s->arena);
+        s->cpu_architecture = strlist_new_arena(s->arena);
+        s->cpu_variant = strlist_new_arena(s->arena);
+        s->cpu_part = strlist_new_arena(s->arena);
+        s->cpu_revision = strlist_new_arena(s->arena);
+        s->decoded_name = strlist_new_arena(s->arena);
+        s->cpukhz_max_str = strlist_new_arena(s->arena);
+        s->each_flag = strlist_new_arena(s->arena);
+        if (!scan_cpu(s, NULL)) {
             arm_proc_free(s);
             return NULL;
         }
+        build_topology(s);
         s->cpu_desc = gen_cpu_desc(s);
         process_flags(s);
+        build_flag_sets(s);
+        if (s->host)
+            s->online = cpu_online_list();
     }
     return s;
 }
 
 void arm_proc_free(arm_proc *s) {
     if(s) {
+        fields_detach(s->fields);
         strlist_free(s->model_name);
         strlist_free(s->flags);
         strlist_free(s->cpu_implementer);
@@ -306,8 +451,14 @@ void arm_proc_free(arm_proc *s) {
         strlist_free(s->decoded_name);
         strlist_free(s->cpukhz_max_str);
         strlist_free(s->each_flag);
+        cpufreq_sampler_free(s->freq);
         fields_free(s->fields);
-        free(s->cpu_desc);
+        topology_free(s->topo);
+        free(s->cores);
+        free(s->decoded_from);
+        free(s->online);
+        arena_free(s->arena);
+        arena_free(s->derived);
         free(s);
     }
 }
@@ -326,18 +477,45 @@ const char *arm_proc_desc(arm_proc *s) {
         return NULL;
 }
 
+/* known flags in table order, then any others found */
+const char *arm_proc_all_flags(arm_proc *s) {
+    if (!s) return NULL;
+    if (!s->all_flags)
+        s->all_flags = strlist_join(s->derived, s->each_flag);
+    return s->all_flags;
+}
+
 int arm_proc_has_flag(arm_proc *s, const char *flag) {
-    int i;
+    cpu_string *cs;
     if (s && flag) {
-        for (i = 0; i < s->each_flag->count; i++) {
-            //DEBUG printf("(%s)...[%d/%d] %s %d\n", flag, i, s->each_flag->count, s->each_flag->strs[i].str, s->each_flag->strs[i].ref_count);
-            if (strcmp(s->each_flag->strs[i].str, flag) == 0)
-                return s->each_flag->strs[i].ref_count;
-        }
+        cs = strlist_find(s->each_flag, flag);
+        if (cs)
+            return cs->ref_count;
+    }
+    return 0;
+}
+
+int arm_proc_core_has_flag(arm_proc *s, int core, const char *flag) {
+    int bit;
+    if (s && flag && core >= 0 && core < s->flag_sets.count) {
+        bit = strlist_pos(s->each_flag, flag);
+        if (bit >= 0)
+            return flagset_test(s->flag_sets.set[core], bit);
     }
     return 0;
 }
 
+int arm_proc_core_flag_count(arm_proc *s, int core) {
+    if (s && core >= 0 && core < s->flag_sets.count)
+        return flagset_count(s->flag_sets.set[core], s->flag_sets.words);
+    return 0;
+}
+
+/* flags some online cores have but not all */
+const char *arm_proc_uncommon_flags(arm_proc *s) {
+    return (s) ? s->flag_sets.uncommon : NULL;
+}
+
 int arm_proc_cores(arm_proc *s) {
     if (s)
         return s->core_count;
@@ -345,6 +523,29 @@ int arm_proc_cores(arm_proc *s) {
         return 0;
 }
 
+int arm_proc_cores_online(arm_proc *s) {
+    int i, n = 0;
+    if (s)
+        for (i = 0; i < s->core_count; i++)
+            n += !!s->cores[i].online;
+    return n;
+}
+
+int arm_proc_core_online(arm_proc *s, int core) {
+    if (s)
+        if (core >= 0 && core < s->core_count)
+            return s->cores[core].online;
+
+    return 0;
+}
+
+cpu_topology *arm_proc_topology(arm_proc *s) {
+    if (s)
+        return s->topo;
+    else
+        return NULL;
+}
+
 int arm_proc_core_from_id(arm_proc *s, int id) {
     int i = 0;
     if (s)
@@ -366,7 +567,7 @@ int arm_proc_core_id(arm_proc *s, int core) {
 int arm_proc_core_khz_min(arm_proc *s, int core) {
     if (s)
         if (core >= 0 && core < s->core_count)
-            return s->cores[core].cpukhz_min;
+            return s->freq->khz_min[core];
 
     return 0;
 }
@@ -374,35 +575,106 @@ int arm_proc_core_khz_min(arm_proc *s, int core) {
 int arm_proc_core_khz_max(arm_proc *s, int core) {
     if (s)
         if (core >= 0 && core < s->core_count)
-            return s->cores[core].cpukhz_max;
+            return s->freq->khz_max[core];
 
     return 0;
 }
 
 int arm_proc_core_khz_cur(arm_proc *s, int core) {
     if (s)
-        if (core >= 0 && core < s->core_count) {
-            get_cpu_freq(s->cores[core].id, NULL, NULL, &s->cores[core].cpukhz_cur);
-            return s->cores[core].cpukhz_cur;
-        }
+        if (core >= 0 && core < s->core_count)
+            return s->freq->khz_cur[core];
+
     return 0;
 }
 
-static char* arm_proc_cores_str(arm_proc *s) {
-    char *buff = NULL;
-    if (s) {
-        buff = malloc(128);
-        if (buff)
-            snprintf(buff, 127, "%d", arm_proc_cores(s) );
-    }
-    return buff;
+/* refresh the khz_cur snapshot of every core in one pass */
+int arm_proc_freq_sample(arm_proc *s) {
+    if (s && s->host)
+        return cpufreq_sample(s->freq);
+    return 0;
+}
+
+static double arm_proc_cores_num(arm_proc *s, int i) {
+    i = i; /* avoid a warning */
+    return arm_proc_cores_online(s);
+}
+
+static const char *arm_proc_topology_str(arm_proc *s) {
+    return topology_summary(arm_proc_topology(s));
 }
 
 #define ADDFIELD(t, l, o, n, f) fields_update_bytag(s->fields, t, l, o, n, (rpiz_fields_get_func)f, (void*)s)
 #define ADDFIELDSTR(t, l, o, n, str) fields_update_bytag(s->fields, t, l, o, n, NULL, (void*)str)
+#define ADDFIELDNUM(t, l, n, f, sc, d, u) fields_update_bytag_num(s->fields, t, l, n, (rpiz_fields_get_num_func)f, (void*)s, 0, sc, d, u)
+/* per-core fields, made only when read */
+enum {
+    CF_MODEL_NAME, CF_DECODED_NAME, CF_IMPLEMENTER, CF_ARCHITECTURE,
+    CF_PART, CF_VARIANT, CF_REVISION, CF_MIDR, CF_REVIDR, CF_TOPOLOGY,
+    CF_N
+};
+
+static const rpiz_field_def core_fields[CF_N] = {
+    { "model_name",       "linux name",     0, NULL },
+    { "decoded_name",     "decoded name",   0, NULL },
+    { "cpu_implementer",  "implementer",    0, NULL },
+    { "cpu_architecture", "architecture",   0, NULL },
+    { "cpu_part",         "part",           0, NULL },
+    { "cpu_variant",      "variant",        0, NULL },
+    { "cpu_revision",     "revision",       0, NULL },
+    { "reg_midr_el1",     "reg_midr_el1",   0, NULL },
+    { "reg_revidr_el1",   "reg_revidr_el1", 0, NULL },
+    { "topology",         "topology",       0, NULL },
+};
+
+/* index is core * CF_N + field */
+static char *core_field(arm_proc *s, int index) {
+    arm_core *c = &s->cores[index / CF_N];
+    char buff[256] = "";
+    switch (index % CF_N) {
+        case CF_MODEL_NAME:
+            snprintf(buff, 256, "%s", c->model_name); break;
+        case CF_DECODED_NAME:
+            snprintf(buff, 256, "%s", c->decoded_name); break;
+        case CF_IMPLEMENTER:
+            snprintf(buff, 256, "[%s] %s", c->cpu_implementer, arm_implementer(c->cpu_implementer) ); break;
+        case CF_ARCHITECTURE:
+            snprintf(buff, 256, "[%s] %s", c->cpu_architecture, arm_arch_more(c->cpu_architecture) ); break;
+        case CF_PART:
+            snprintf(buff, 256, "[%s] %s", c->cpu_part, arm_part(c->cpu_implementer, c->cpu_part) ); break;
+        case CF_VARIANT:
+            snprintf(buff, 256, "%s", c->cpu_variant ); break;
+        case CF_REVISION:
+            snprintf(buff, 256, "%s", c->cpu_revision ); break;
+        case CF_MIDR:
+            snprintf(buff, 256, "0x%016llx", c->reg_midr_el1 ); break;
+        case CF_REVIDR:
+            snprintf(buff, 256, "0x%016llx", c->reg_revidr_el1 ); break;
+        case CF_TOPOLOGY:
+            topology_cpu_str(s->topo, c->id, buff, 256); break;
+    }
+    return strdup(buff);
+}
+
+/* fields for core i, s->fields must already exist */
+static void add_core_fields(arm_proc *s, int i) {
+    fields_add_table_at(s->fields, "cpu.thread", i, s->cores[i].id, core_fields, CF_N,
+        (rpiz_fields_get_at_func)core_field, NULL, (void*)s);
+}
+
+/* build_topology() may have renumbered the cores, so each
+ * topology field read before is made again */
+static void expire_topology_fields(arm_proc *s, int count) {
+    char bt[256] = "";
+    int i;
+    for (i = 0; i < count; i++) {
+        sprintf(bt, "cpu.thread[%d].%s", i, core_fields[CF_TOPOLOGY].tag);
+        fields_expire_bytag(s->fields, bt);
+    }
+}
+
 rpiz_fields *arm_proc_fields(arm_proc *s) {
     int i;
-    char bn[256] = "", bt[256] = "", bv[256] = "", *bvp;
     if (s) {
         if (!s->fields) {
             /* first insert creates */
@@ -410,62 +682,74 @@ rpiz_fields *arm_proc_fields(arm_proc *s) {
             ADDFIELD("summary.proc_desc", 0, 0, "Proccesor", arm_proc_desc );
             ADDFIELD("cpu.name",          0, 0, "Proccesor Name", arm_proc_name );
             ADDFIELD("cpu.desc",          0, 0, "Proccesor Description", arm_proc_desc );
-            ADDFIELD("cpu.count",         0, 1, "Core Count", arm_proc_cores_str );
-
-            for(i = 0; i < s->core_count; i++) {
-                sprintf(bt, "cpu.thread[%d].model_name", i);
-                sprintf(bn, "[%d] linux name", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].model_name);
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].decoded_name", i);
-                sprintf(bn, "[%d] decoded name", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].decoded_name);
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].cpu_implementer", i);
-                sprintf(bn, "[%d] implementer", s->cores[i].id);
-                sprintf(bv, "[%s] %s", s->cores[i].cpu_implementer, arm_implementer(s->cores[i].cpu_implementer) );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].cpu_architecture", i);
-                sprintf(bn, "[%d] architecture", s->cores[i].id);
-                sprintf(bv, "[%s] %s", s->cores[i].cpu_architecture, arm_arch_more(s->cores[i].cpu_architecture) );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].cpu_part", i);
-                sprintf(bn, "[%d] part", s->cores[i].id);
-                sprintf(bv, "[%s] %s", s->cores[i].cpu_part, arm_part(s->cores[i].cpu_implementer, s->cores[i].cpu_part) );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].cpu_variant", i);
-                sprintf(bn, "[%d] variant", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].cpu_variant );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].cpu_revision", i);
-                sprintf(bn, "[%d] revision", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].cpu_revision );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].reg_midr_el1", i);
-                sprintf(bn, "[%d] reg_midr_el1", s->cores[i].id);
-                sprintf(bv, "0x%016llx", s->cores[i].reg_midr_el1 );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].reg_revidr_el1", i);
-                sprintf(bn, "[%d] reg_revidr_el1", s->cores[i].id);
-                sprintf(bv, "0x%016llx", s->cores[i].reg_revidr_el1 );
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-            }
+            ADDFIELDNUM("cpu.count",      0, "Core Count", arm_proc_cores_num, 1, 0, NULL );
+            ADDFIELD("cpu.topology",      0, 0, "Topology", arm_proc_topology_str );
 
+            for(i = 0; i < s->core_count; i++)
+                add_core_fields(s, i);
         }
         return s->fields;
     }
     return NULL;
 }
 
+/* compare the kernel's online cpu list with the last one seen,
+ * cores going offline are kept but no longer counted, and only
+ * cores not seen before are read from /proc/cpuinfo.
+ * returns 1 if anything changed. */
+int arm_proc_update(arm_proc *s) {
+    char *online;
+    int i, known, first, on;
+    if (!s || !s->host) return 0;
+
+    online = cpu_online_list();
+    if (!online) return 0;
+    if (s->online && strcmp(online, s->online) == 0) {
+        free(online);
+        return 0;
+    }
+
+    for (i = 0, known = 0; i < s->core_count; i++) {
+        on = cpulist_has(online, s->cores[i].id);
+        if (on != s->cores[i].online) {
+            core_weight(s, i, on ? 1 : -1);
+            s->cores[i].online = on;
+        }
+        known += on;
+    }
+
+    first = s->core_count;
+    if (cpulist_count(online) > known) {
+        scan_cpu(s, online);
+        for (i = first; i < s->core_count; i++)
+            add_flags(s, s->cores[i].flags, 1);
+    }
+
+    build_topology(s);
+    /* made from the cores again, in the memory of the last ones */
+    arena_reset(s->derived);
+    s->all_flags = NULL;
+    build_flag_sets(s);
+    s->cpu_desc = gen_cpu_desc(s);
+    if (s->fields) {
+        expire_topology_fields(s, first);
+        for (i = first; i < s->core_count; i++)
+            add_core_fields(s, i);
+    }
+
+    free(s->online);
+    s->online = online;
+    s->generation++;
+    live_cache_flush();
+    return 1;
+}
+
+int arm_proc_generation(arm_proc *s) {
+    if (s)
+        return s->generation;
+    return 0;
+}
+
 #ifdef DEBUG_ARMCPU
 
 static void dump(arm_proc *p) {
@@ -486,12 +770,12 @@ static void dump(arm_proc *p) {
             printf(".proc.core[%d].cpu_part = [%s] %s\n", i, p->cores[i].cpu_part, arm_part(p->cores[i].cpu_implementer, p->cores[i].cpu_part) );
             printf(".proc.core[%d].cpu_revision = %s\n", i, p->cores[i].cpu_revision);
             printf(".proc.core[%d].freq_khz(min - max / cur) = %d - %d / %d\n", i,
-                p->cores[i].cpukhz_min, p->cores[i].cpukhz_max, p->cores[i].cpukhz_cur );
+                p->freq->khz_min[i], p->freq->khz_max[i], p->freq->khz_cur[i] );
             printf(".proc.core[%d].reg_midr_el1 = 0x%016llx\n", i, p->cores[i].reg_midr_el1);
             printf(".proc.core[%d].reg_revidr_el1 = 0x%016llx\n", i, p->cores[i].reg_revidr_el1);
         }
     }
-    printf(".all_flags = %s (len: %d)\n", arm_flag_list(), (int)strlen( arm_flag_list() ) );
+    printf(".all_flags = %s (len: %d)\n", arm_proc_all_flags(p), (int)strlen( arm_proc_all_flags(p) ) );
 }
 
 int main(void) {
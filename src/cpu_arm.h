@@ -24,22 +24,34 @@
 #include "fields.h"
 
 #include "arm_data.h"
+#include "topology.h"
 const char *arm_flag_list(void);
 
 typedef struct arm_proc arm_proc;
 
 arm_proc *arm_proc_new(void);
+arm_proc *arm_proc_new_file(const char *path); /* any machine's cpuinfo */
 void arm_proc_free(arm_proc *);
 
 const char *arm_proc_name(arm_proc *);
 const char *arm_proc_desc(arm_proc *);
+const char *arm_proc_all_flags(arm_proc *);
 int arm_proc_has_flag(arm_proc *, const char *flag); /* returns core count with flag */
-int arm_proc_cores(arm_proc *);
+int arm_proc_core_has_flag(arm_proc *, int core, const char *flag);
+int arm_proc_core_flag_count(arm_proc *, int core);
+const char *arm_proc_uncommon_flags(arm_proc *); /* flags not on every core */
+int arm_proc_cores(arm_proc *); /* includes cores gone offline */
+int arm_proc_cores_online(arm_proc *);
+int arm_proc_core_online(arm_proc *, int core);
+cpu_topology *arm_proc_topology(arm_proc *);
 int arm_proc_core_from_id(arm_proc *, int id); /* -1 if not found */
 int arm_proc_core_id(arm_proc *, int core);
 int arm_proc_core_khz_min(arm_proc *, int core);
 int arm_proc_core_khz_max(arm_proc *, int core);
-int arm_proc_core_khz_cur(arm_proc *, int core);
+int arm_proc_core_khz_cur(arm_proc *, int core); /* from the last arm_proc_freq_sample() */
+int arm_proc_freq_sample(arm_proc *);
+int arm_proc_update(arm_proc *); /* rescan after hotplug, 1 if changed */
+int arm_proc_generation(arm_proc *); /* bumped by each change */
 
 rpiz_fields *arm_proc_fields(arm_proc *);
 
@@ -22,59 +22,55 @@
 #include <stdio.h>
 #include <string.h>
 #include "util.h"
+#include "cpuinfo.h"
 #include "cpu_riscv.h"
 
-#define MAX_CORES 128
-
-static int search_for_flag(char *flags, const char *flag) {
-    char *p = strstr(flags, flag);
-    int l = strlen(flag);
-    int front = 0, back = 0;
-    //DEBUG printf("search_for_flag( %x, \"%s\")\n", flags, flag);
-    if (strlen(flag) == 0 || strchr(flag, ' ') )
-        return 0;
-    while (p) {
-        if (p == flags) front = 1;
-        else if (*(p - 1) == ' ') front = 1;
-        if (*(p + l) == ' ' || *(p + l) == '\0')
-            back = 1;
-        if (front && back)
-            return 1;
-        p = strstr(p + l, flag);
-    }
-    return 0;
-}
 
 typedef struct {
     int id; /* hart */
-    int cpukhz_min, cpukhz_max, cpukhz_cur;
 
     /* point to a cpu_string.str */
     char *model_name;
     char *isa;
     char *flags; /* extensions as flag list */
     char *cpukhz_max_str;
+
+    int online; /* offline cores are kept, but not counted */
 } riscv_core;
 
 struct riscv_proc {
+    rpiz_arena *arena; /* owns the strings below */
+    rpiz_arena *derived; /* cpu_desc, all_flags and flag_sets, made again by each update */
+
     cpu_string_list *model_name;
     cpu_string_list *isa;
     cpu_string_list *flags;
     cpu_string_list *cpukhz_max_str;
 
+    /* the known extensions from riscv_data.c come first, in table
+     * order, followed by any others found. ref_count is cores with flag */
     cpu_string_list *each_flag;
+    char *all_flags; /* each_flag joined, built when first asked for */
+    cpu_flag_sets flag_sets; /* over each_flag, per core */
 
     char cpu_name[256];
     char *cpu_desc;
     int max_khz;
+    cpufreq_sampler *freq;
     int core_count;
-    riscv_core cores[MAX_CORES];
+    riscv_core *cores;
+    int core_alloc;
+    cpu_topology *topo; /* of online cores */
+
+    const char *path; /* the cpuinfo read */
+    int host; /* path is this machine's, so sysfs applies */
+    char *online; /* /sys/devices/system/cpu/online as of the last update */
+    int generation;
 
     rpiz_fields *fields;
 };
 
-#define CHECK_FOR(k) (strncmp(k, key, (strlen(k) < strlen(key)) ? strlen(k) : strlen(key)) == 0)
-#define GET_STR(k, s) if (CHECK_FOR(k)) { p->cores[core].s = strlist_add(p->s, value); continue; }
+#define GET_STR(k, s) case k: p->cores[core].s = strlist_add_n(p->s, value.str, value.len); break;
 #define FIN_PROC() if (core >= 0) if (!p->cores[core].model_name) { p->cores[core].model_name = strlist_add(p->model_name, rep_pname); }
 
 #define REDUP(f) if(p->cores[di].f && !p->cores[i].f) { p->cores[i].f = strlist_add(p->f, p->cores[di].f); }
@@ -83,45 +79,85 @@ struct riscv_proc {
 #define PROC_CPUINFO "/proc/cpuinfo"
 #endif
 
-static int scan_cpu(riscv_proc* p) {
-    kv_scan *kv; char *key, *value;
-    int core = -1;
+/* grow cores[] to hold at least n, doubling */
+static int reserve_cores(riscv_proc *p, int n) {
+    riscv_core *tmp;
+    int na;
+    if (n <= p->core_alloc) return 1;
+    na = (p->core_alloc) ? p->core_alloc * 2 : 8;
+    while (na < n) na *= 2;
+    tmp = realloc(p->cores, sizeof(riscv_core) * na);
+    if (!tmp) return 0;
+    p->cores = tmp;
+    p->core_alloc = na;
+    return 1;
+}
+
+/* if only is given, just the cores in that cpu list that aren't
+ * already known are read, and added after the known ones */
+static int scan_cpu(riscv_proc* p, const char *only) {
+    kv_scan *kv; kv_slice key, value;
+    cpuinfo_key ck;
+    int core, first;
+    int skip = (only != NULL);
     int i, di;
     char rep_pname[256] = "RISC-V Processor";
     char tmp_maxfreq[128] = "";
+    char *tmp_flags = NULL;
 
     if (!p) return 0;
+    first = p->core_count;
+    core = first - 1;
 
-    kv = kv_new_file(PROC_CPUINFO);
+    kv = kv_new_file(p->path);
     if (kv) {
-        while( kv_next(kv, &key, &value) ) {
-            if (CHECK_FOR("Processor")) {
-                strcpy(rep_pname, value);
-                continue;
-            }
-
-            if (CHECK_FOR("hart")) {
-                FIN_PROC();
-                core++;
-                memset(&p->cores[core], 0, sizeof(riscv_core));
-                p->cores[core].id = atoi(value);
-                continue;
-            }
-
-            if (core < 0) {
-                if ( CHECK_FOR("isa")
-                     || CHECK_FOR("isa")
-                     || CHECK_FOR("isa") ) {
-                    /* this cpuinfo doesn't provide hart : n
-                     * there is prolly only one core */
+        while( kv_next_slice(kv, &key, &value, KV_TRIM) ) {
+            ck = cpuinfo_key_lookup(key.str, key.len);
+            switch(ck) {
+                case CPUINFO_UNKNOWN:
+                    continue;
+                case CPUINFO_PROCESSOR_NAME:
+                    kv_slice_copy(&value, rep_pname, sizeof(rep_pname));
+                    continue;
+                case CPUINFO_HART:
+                    FIN_PROC();
+                    if (only) {
+                        i = atoi(value.str);
+                        skip = !cpulist_has(only, i) || riscv_proc_core_from_id(p, i) >= 0;
+                        if (skip) continue;
+                    }
                     core++;
+                    if (!reserve_cores(p, core + 1)) {
+                        kv_free(kv);
+                        return 0;
+                    }
                     memset(&p->cores[core], 0, sizeof(riscv_core));
-                    p->cores[core].id = 0;
-                }
+                    p->cores[core].id = atoi(value.str);
+                    p->cores[core].online = 1;
+                    continue;
+                case CPUINFO_ISA:
+                    if (core < 0) {
+                        /* this cpuinfo doesn't provide hart : n
+                         * there is prolly only one core */
+                        core++;
+                        if (!reserve_cores(p, core + 1)) {
+                            kv_free(kv);
+                            return 0;
+                        }
+                        memset(&p->cores[core], 0, sizeof(riscv_core));
+                        p->cores[core].id = 0;
+                        p->cores[core].online = 1;
+                    }
+                    break;
+                default:
+                    break;
             }
-            if (core >= 0) {
-                GET_STR("model name", model_name);
-                GET_STR("isa", isa);
+            if (core < 0 || skip) continue;
+            switch(ck) {
+                GET_STR(CPUINFO_MODEL_NAME, model_name);
+                GET_STR(CPUINFO_ISA, isa);
+                default:
+                    break;
             }
         }
         FIN_PROC();
@@ -133,7 +169,7 @@ static int scan_cpu(riscv_proc* p) {
 
     /* re-duplicate missing data for /proc/cpuinfo variant that de-duplicated it */
     di = p->core_count - 1;
-    for (i = di; i >= 0; i--) {
+    for (i = di; i >= first; i--) {
         if (p->cores[i].isa)
             di = i;
         else {
@@ -141,115 +177,187 @@ static int scan_cpu(riscv_proc* p) {
         }
     }
 
+    /* cpufreq, one sampler for all cores */
+    p->freq = cpufreq_sampler_grow(p->freq, p->core_count);
+    if (!p->freq)
+        return 0;
+    for (i = first; i < p->core_count; i++)
+        p->freq->id[i] = p->cores[i].id;
+    if (p->host)
+        cpufreq_read_limits_from(p->freq, first);
+
     /* data not from /proc/cpuinfo */
-    for (i = 0; i < p->core_count; i++) {
+    for (i = first; i < p->core_count; i++) {
         /* flags */
-        p->cores[i].flags = riscv_isa_to_flags(p->cores[i].isa);
+        tmp_flags = riscv_isa_to_flags(p->cores[i].isa);
+        if (tmp_flags) {
+            p->cores[i].flags = strlist_add(p->flags, tmp_flags);
+            free(tmp_flags); tmp_flags = NULL;
+        }
 
         /* freq */
-        get_cpu_freq(p->cores[i].id, &p->cores[i].cpukhz_min, &p->cores[i].cpukhz_max, &p->cores[i].cpukhz_cur);
-        sprintf(tmp_maxfreq, "%d", p->cores[i].cpukhz_max);
+        sprintf(tmp_maxfreq, "%d", p->freq->khz_max[i]);
         p->cores[i].cpukhz_max_str = strlist_add(p->cpukhz_max_str, tmp_maxfreq);
-        if (p->cores[i].cpukhz_max > p->max_khz)
-            p->max_khz = p->cores[i].cpukhz_max;
+        if (p->freq->khz_max[i] > p->max_khz)
+            p->max_khz = p->freq->khz_max[i];
     }
 
     return 1;
 }
 
+/* cpuinfo has no topology on riscv, so without sysfs
+ * every hart is its own core, in one package */
+static void build_topology(riscv_proc *p) {
+    int i;
+    if (!p->topo)
+        p->topo = topology_new();
+    topology_clear(p->topo);
+    for (i = 0; i < p->core_count; i++)
+        if (p->cores[i].online)
+            topology_add_cpu(p->topo, p->cores[i].id, -1, -1);
+    topology_build(p->topo, p->host);
+}
+
+/* entries with no online cores left are skipped */
 static char *gen_cpu_desc(riscv_proc *p) {
-    char *ret = NULL;
+    char ret[4096] = "";
     char tmp[1024];
-    int i, l = 0;
+    int i, n, l = 0;
     float maxfreq;
     if (p) {
-        ret = malloc(4096);
-        memset(ret, 0, 4096);
-        for (i = 0; i < p->model_name->count; i++) {
+        for (i = 0, n = 0; i < p->model_name->count; i++) {
+            if (p->model_name->strs[i].ref_count <= 0) continue;
             sprintf(tmp, "%dx %s", p->model_name->strs[i].ref_count, p->model_name->strs[i].str);
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
         sprintf(ret + l, "; "); l += 2;
-        for (i = 0; i < p->cpukhz_max_str->count; i++) {
+        for (i = 0, n = 0; i < p->cpukhz_max_str->count; i++) {
+            if (p->cpukhz_max_str->strs[i].ref_count <= 0) continue;
             maxfreq = atof(p->cpukhz_max_str->strs[i].str);
             if (maxfreq)
                 maxfreq /= 1000;
             else
                 maxfreq = 0.0f;
             sprintf(tmp, "%dx %0.2f MHz", p->cpukhz_max_str->strs[i].ref_count, maxfreq);
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
     }
-    return ret;
+    return (p) ? arena_strdup(p->derived, ret) : NULL;
+}
+
+/* add weight to each flag of a flags string. each_flag is the set
+ * of known flags, returns how many weren't in it */
+static int add_flags(riscv_proc *s, const char *flags, int weight) {
+    const char *w;
+    int len, before;
+    if (!s || !flags) return 0;
+
+    before = s->each_flag->count;
+    while ((len = str_next_word(&flags, &w)))
+        if (len <= 15)
+            strlist_add_wn(s->each_flag, w, len, weight);
+    if (s->each_flag->count != before)
+        s->all_flags = NULL;
+    return s->each_flag->count - before;
 }
 
-#define APPEND_FLAG(f) strcat(all_flags, f); strcat(all_flags, " ");
 static void process_flags(riscv_proc *s) {
-    char flag[16] = "";
-    char *all_flags; /* riscv_data.c: static char all_flags[1024] */
-    char *cur, *next;
+    const char *name;
     int added_count = 0, i;
     if (!s) return;
 
-    all_flags = (char*)riscv_ext_list();
-    for(i = 0; i < s->flags->count; i++) {
-        if (s->flags->strs[i].str) {
-            cur = s->flags->strs[i].str;
-            next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-            while(next) {
-                if (next-cur <= 15) {
-                    memset(flag, 0, 16);
-                    strncpy(flag, cur, next-cur);
-                    if (strlen(flag) > 0) {
-                        /* add it to the string list, copy the flag string's ref_count */
-                        strlist_add_w(s->each_flag, flag, s->flags->strs[i].ref_count);
-
-                        /* add it to the list of known all flags, if it isn't there */
-                        if (!search_for_flag(all_flags, flag)) {
-                            APPEND_FLAG(flag);
-                            added_count++;
-                        }
-                    }
-                }
-                if (*next == '\0') break;
-                cur = next + 1;
-                next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-            }
-        }
-    }
+    for (i = 0; (name = riscv_ext_name(i)); i++)
+        strlist_add_w(s->each_flag, name, 0);
+
+    for(i = 0; i < s->flags->count; i++)
+        added_count += add_flags(s, s->flags->strs[i].str, s->flags->strs[i].ref_count);
     // DEBUG printf("add_unknown_flags(): added %d previously unknown flags\n", added_count);
 }
 
+#define REWEIGHT(f) if (c->f) strlist_add_w(s->f, c->f, weight);
+/* add weight to the ref_count of everything core i points at */
+static void core_weight(riscv_proc *s, int i, int weight) {
+    riscv_core *c = &s->cores[i];
+    REWEIGHT(model_name);
+    REWEIGHT(isa);
+    REWEIGHT(flags);
+    REWEIGHT(cpukhz_max_str);
+    add_flags(s, c->flags, weight);
+}
+
+/* each core's flags as a set over each_flag,
+ * cores with the same flags string share one */
+static void build_flag_sets(riscv_proc *s) {
+    const char **flags;
+    uint64_t *online;
+    int i;
+    if (!s) return;
+
+    flags = arena_alloc(s->derived, sizeof(char*) * (s->core_count + 1));
+    online = flagset_new(s->derived, FLAGSET_WORDS(s->core_count));
+    if (!flags || !online) return;
+    for (i = 0; i < s->core_count; i++) {
+        flags[i] = s->cores[i].flags;
+        if (s->cores[i].online)
+            flagset_set(online, i);
+    }
+    flag_sets_build(&s->flag_sets, s->derived, s->core_count, flags, NULL, 1, online, s->each_flag);
+}
+
 riscv_proc *riscv_proc_new(void) {
-    riscv_proc *s = malloc( sizeof(riscv_proc) );
+    return riscv_proc_new_file(PROC_CPUINFO);
+}
+
+/* a cpuinfo dump from any machine, sysfs is only read
+ * when it is this machine's own cpuinfo */
+riscv_proc *riscv_proc_new_file(const char *path) {
+    riscv_proc *s;
+    if (!path) return NULL;
+    s = malloc( sizeof(riscv_proc) );
     if (s) {
         memset(s, 0, sizeof(*s));
-        s->model_name = strlist_new();
-        s->isa = strlist_new();
-        s->flags = strlist_new();
-        s->cpukhz_max_str = strlist_new();
-        s->each_flag = strlist_new();
-        if (!scan_cpu(s)) {
+        s->arena = arena_new();
+        s->derived = arena_new();
+        s->path = arena_strdup(s->arena, path);
+        s->host = (strcmp(path, PROC_CPUINFO) == 0);
+        s->model_name = strlist_new_arena(s->arena);
+        s->isa = strlist_new_arena(s->arena);
+        s->flags = strlist_new_arena(s->arena);
+        s->cpukhz_max_str = strlist_new_arena(s->arena);
+        s->each_flag = strlist_new_arena(s->arena);
+        if (!scan_cpu(s, NULL)) {
             riscv_proc_free(s);
             return NULL;
         }
+        build_topology(s);
         s->cpu_desc = gen_cpu_desc(s);
         process_flags(s);
+        build_flag_sets(s);
+        if (s->host)
+            s->online = cpu_online_list();
     }
     return s;
 }
 
 void riscv_proc_free(riscv_proc *s) {
     if(s) {
+        fields_detach(s->fields);
         strlist_free(s->model_name);
         strlist_free(s->isa);
         strlist_free(s->flags);
         strlist_free(s->cpukhz_max_str);
         strlist_free(s->each_flag);
+        cpufreq_sampler_free(s->freq);
         fields_free(s->fields);
-        free(s->cpu_desc);
+        topology_free(s->topo);
+        free(s->cores);
+        free(s->online);
+        arena_free(s->arena);
+        arena_free(s->derived);
         free(s);
     }
 }
@@ -268,18 +376,45 @@ const char *riscv_proc_desc(riscv_proc *s) {
         return NULL;
 }
 
+/* known flags in table order, then any others found */
+const char *riscv_proc_all_flags(riscv_proc *s) {
+    if (!s) return NULL;
+    if (!s->all_flags)
+        s->all_flags = strlist_join(s->derived, s->each_flag);
+    return s->all_flags;
+}
+
 int riscv_proc_has_flag(riscv_proc *s, const char *flag) {
-    int i;
+    cpu_string *cs;
     if (s && flag) {
-        for (i = 0; i < s->each_flag->count; i++) {
-            //DEBUG printf("(%s)...[%d/%d] %s %d\n", flag, i, s->each_flag->count, s->each_flag->strs[i].str, s->each_flag->strs[i].ref_count);
-            if (strcmp(s->each_flag->strs[i].str, flag) == 0)
-                return s->each_flag->strs[i].ref_count;
-        }
+        cs = strlist_find(s->each_flag, flag);
+        if (cs)
+            return cs->ref_count;
+    }
+    return 0;
+}
+
+int riscv_proc_core_has_flag(riscv_proc *s, int core, const char *flag) {
+    int bit;
+    if (s && flag && core >= 0 && core < s->flag_sets.count) {
+        bit = strlist_pos(s->each_flag, flag);
+        if (bit >= 0)
+            return flagset_test(s->flag_sets.set[core], bit);
     }
     return 0;
 }
 
+int riscv_proc_core_flag_count(riscv_proc *s, int core) {
+    if (s && core >= 0 && core < s->flag_sets.count)
+        return flagset_count(s->flag_sets.set[core], s->flag_sets.words);
+    return 0;
+}
+
+/* flags some online cores have but not all */
+const char *riscv_proc_uncommon_flags(riscv_proc *s) {
+    return (s) ? s->flag_sets.uncommon : NULL;
+}
+
 int riscv_proc_cores(riscv_proc *s) {
     if (s)
         return s->core_count;
@@ -287,6 +422,29 @@ int riscv_proc_cores(riscv_proc *s) {
         return 0;
 }
 
+int riscv_proc_cores_online(riscv_proc *s) {
+    int i, n = 0;
+    if (s)
+        for (i = 0; i < s->core_count; i++)
+            n += !!s->cores[i].online;
+    return n;
+}
+
+int riscv_proc_core_online(riscv_proc *s, int core) {
+    if (s)
+        if (core >= 0 && core < s->core_count)
+            return s->cores[core].online;
+
+    return 0;
+}
+
+cpu_topology *riscv_proc_topology(riscv_proc *s) {
+    if (s)
+        return s->topo;
+    else
+        return NULL;
+}
+
 int riscv_proc_core_from_id(riscv_proc *s, int id) {
     int i = 0;
     if (s)
@@ -308,7 +466,7 @@ int riscv_proc_core_id(riscv_proc *s, int core) {
 int riscv_proc_core_khz_min(riscv_proc *s, int core) {
     if (s)
         if (core >= 0 && core < s->core_count)
-            return s->cores[core].cpukhz_min;
+            return s->freq->khz_min[core];
 
     return 0;
 }
@@ -316,35 +474,84 @@ int riscv_proc_core_khz_min(riscv_proc *s, int core) {
 int riscv_proc_core_khz_max(riscv_proc *s, int core) {
     if (s)
         if (core >= 0 && core < s->core_count)
-            return s->cores[core].cpukhz_max;
+            return s->freq->khz_max[core];
 
     return 0;
 }
 
 int riscv_proc_core_khz_cur(riscv_proc *s, int core) {
     if (s)
-        if (core >= 0 && core < s->core_count) {
-            get_cpu_freq(s->cores[core].id, NULL, NULL, &s->cores[core].cpukhz_cur);
-            return s->cores[core].cpukhz_cur;
-        }
+        if (core >= 0 && core < s->core_count)
+            return s->freq->khz_cur[core];
+
     return 0;
 }
 
-static char* riscv_proc_cores_str(riscv_proc *s) {
-    char *buff = NULL;
-    if (s) {
-        buff = malloc(128);
-        if (buff)
-            snprintf(buff, 127, "%d", riscv_proc_cores(s) );
-    }
-    return buff;
+/* refresh the khz_cur snapshot of every core in one pass */
+int riscv_proc_freq_sample(riscv_proc *s) {
+    if (s && s->host)
+        return cpufreq_sample(s->freq);
+    return 0;
+}
+
+static double riscv_proc_cores_num(riscv_proc *s, int i) {
+    i = i; /* avoid a warning */
+    return riscv_proc_cores_online(s);
+}
+
+static const char *riscv_proc_topology_str(riscv_proc *s) {
+    return topology_summary(riscv_proc_topology(s));
 }
 
 #define ADDFIELD(t, l, o, n, f) fields_update_bytag(s->fields, t, l, o, n, (rpiz_fields_get_func)f, (void*)s)
 #define ADDFIELDSTR(t, l, o, n, str) fields_update_bytag(s->fields, t, l, o, n, NULL, (void*)str)
+#define ADDFIELDNUM(t, l, n, f, sc, d, u) fields_update_bytag_num(s->fields, t, l, n, (rpiz_fields_get_num_func)f, (void*)s, 0, sc, d, u)
+/* per-core fields, made only when read */
+enum {
+    CF_MODEL_NAME, CF_ISA, CF_TOPOLOGY,
+    CF_N
+};
+
+static const rpiz_field_def core_fields[CF_N] = {
+    { "model_name", "linux name", 0, NULL },
+    { "isa",        "isa",        0, NULL },
+    { "topology",   "topology",   0, NULL },
+};
+
+/* index is core * CF_N + field */
+static char *core_field(riscv_proc *s, int index) {
+    riscv_core *c = &s->cores[index / CF_N];
+    char buff[256] = "";
+    switch (index % CF_N) {
+        case CF_MODEL_NAME:
+            snprintf(buff, 256, "%s", c->model_name); break;
+        case CF_ISA:
+            snprintf(buff, 256, "%s", c->isa); break;
+        case CF_TOPOLOGY:
+            topology_cpu_str(s->topo, c->id, buff, 256); break;
+    }
+    return strdup(buff);
+}
+
+/* fields for core i, s->fields must already exist */
+static void add_core_fields(riscv_proc *s, int i) {
+    fields_add_table_at(s->fields, "cpu.thread", i, s->cores[i].id, core_fields, CF_N,
+        (rpiz_fields_get_at_func)core_field, NULL, (void*)s);
+}
+
+/* build_topology() may have renumbered the cores, so each
+ * topology field read before is made again */
+static void expire_topology_fields(riscv_proc *s, int count) {
+    char bt[256] = "";
+    int i;
+    for (i = 0; i < count; i++) {
+        sprintf(bt, "cpu.thread[%d].%s", i, core_fields[CF_TOPOLOGY].tag);
+        fields_expire_bytag(s->fields, bt);
+    }
+}
+
 rpiz_fields *riscv_proc_fields(riscv_proc *s) {
     int i;
-    char bn[256] = "", bt[256] = "", bv[256] = "", *bvp;
     if (s) {
         if (!s->fields) {
             /* first insert creates */
@@ -352,23 +559,71 @@ rpiz_fields *riscv_proc_fields(riscv_proc *s) {
             ADDFIELD("summary.proc_desc", 0, 0, "Proccesor", riscv_proc_desc );
             ADDFIELD("cpu.name",          0, 0, "Proccesor Name", riscv_proc_name );
             ADDFIELD("cpu.desc",          0, 0, "Proccesor Description", riscv_proc_desc );
-            ADDFIELD("cpu.count",         0, 1, "Core Count", riscv_proc_cores_str );
-
-            for(i = 0; i < s->core_count; i++) {
-                sprintf(bt, "cpu.thread[%d].model_name", i);
-                sprintf(bn, "[%d] linux name", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].model_name);
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-
-                sprintf(bt, "cpu.thread[%d].isa", i);
-                sprintf(bn, "[%d] isa", s->cores[i].id);
-                sprintf(bv, "%s", s->cores[i].isa);
-                bvp = strdup(bv); ADDFIELDSTR(bt, 0, 1, bn, bvp);
-            }
+            ADDFIELDNUM("cpu.count",      0, "Core Count", riscv_proc_cores_num, 1, 0, NULL );
+            ADDFIELD("cpu.topology",      0, 0, "Topology", riscv_proc_topology_str );
 
+            for(i = 0; i < s->core_count; i++)
+                add_core_fields(s, i);
         }
         return s->fields;
     }
     return NULL;
 }
 
+/* compare the kernel's online cpu list with the last one seen,
+ * cores going offline are kept but no longer counted, and only
+ * cores not seen before are read from /proc/cpuinfo.
+ * returns 1 if anything changed. */
+int riscv_proc_update(riscv_proc *s) {
+    char *online;
+    int i, known, first, on;
+    if (!s || !s->host) return 0;
+
+    online = cpu_online_list();
+    if (!online) return 0;
+    if (s->online && strcmp(online, s->online) == 0) {
+        free(online);
+        return 0;
+    }
+
+    for (i = 0, known = 0; i < s->core_count; i++) {
+        on = cpulist_has(online, s->cores[i].id);
+        if (on != s->cores[i].online) {
+            core_weight(s, i, on ? 1 : -1);
+            s->cores[i].online = on;
+        }
+        known += on;
+    }
+
+    first = s->core_count;
+    if (cpulist_count(online) > known) {
+        scan_cpu(s, online);
+        for (i = first; i < s->core_count; i++)
+            add_flags(s, s->cores[i].flags, 1);
+    }
+
+    build_topology(s);
+    /* made from the cores again, in the memory of the last ones */
+    arena_reset(s->derived);
+    s->all_flags = NULL;
+    build_flag_sets(s);
+    s->cpu_desc = gen_cpu_desc(s);
+    if (s->fields) {
+        expire_topology_fields(s, first);
+        for (i = first; i < s->core_count; i++)
+            add_core_fields(s, i);
+    }
+
+    free(s->online);
+    s->online = online;
+    s->generation++;
+    live_cache_flush();
+    return 1;
+}
+
+int riscv_proc_generation(riscv_proc *s) {
+    if (s)
+        return s->generation;
+    return 0;
+}
+
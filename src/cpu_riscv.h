@@ -24,22 +24,34 @@
 #include "fields.h"
 
 #include "riscv_data.h"
+#include "topology.h"
 const char *riscv_flag_list(void);
 
 typedef struct riscv_proc riscv_proc;
 
 riscv_proc *riscv_proc_new(void);
+riscv_proc *riscv_proc_new_file(const char *path); /* any machine's cpuinfo */
 void riscv_proc_free(riscv_proc *);
 
 const char *riscv_proc_name(riscv_proc *);
 const char *riscv_proc_desc(riscv_proc *);
+const char *riscv_proc_all_flags(riscv_proc *);
 int riscv_proc_has_flag(riscv_proc *, const char *flag); /* returns core count with flag */
-int riscv_proc_cores(riscv_proc *);
+int riscv_proc_core_has_flag(riscv_proc *, int core, const char *flag);
+int riscv_proc_core_flag_count(riscv_proc *, int core);
+const char *riscv_proc_uncommon_flags(riscv_proc *); /* flags not on every core */
+int riscv_proc_cores(riscv_proc *); /* includes cores gone offline */
+int riscv_proc_cores_online(riscv_proc *);
+int riscv_proc_core_online(riscv_proc *, int core);
+cpu_topology *riscv_proc_topology(riscv_proc *);
 int riscv_proc_core_from_id(riscv_proc *, int id); /* -1 if not found */
 int riscv_proc_core_id(riscv_proc *, int core);
 int riscv_proc_core_khz_min(riscv_proc *, int core);
 int riscv_proc_core_khz_max(riscv_proc *, int core);
-int riscv_proc_core_khz_cur(riscv_proc *, int core);
+int riscv_proc_core_khz_cur(riscv_proc *, int core); /* from the last riscv_proc_freq_sample() */
+int riscv_proc_freq_sample(riscv_proc *);
+int riscv_proc_update(riscv_proc *); /* rescan after hotplug, 1 if changed */
+int riscv_proc_generation(riscv_proc *); /* bumped by each change */
 
 rpiz_fields *riscv_proc_fields(riscv_proc *);
 
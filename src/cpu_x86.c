@@ -22,9 +22,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "util.h"
+#include "cpuinfo.h"
 #include "cpu_x86.h"
 
-#define MAX_THREADS 128
 
 static const char unk[] = "";
 
@@ -48,8 +48,8 @@ static int search_for_flag(char *flags, const char *flag) {
 }
 
 typedef struct {
-    int id, core, proc;
-    int cpukhz_min, cpukhz_max, cpukhz_cur;
+    int id;
+    int core, proc; /* core id and physical id from cpuinfo, -1 if not given */
 
     /* point to a cpu_string.str */
     char *model_name;
@@ -63,9 +63,14 @@ typedef struct {
     char *core_id;
 
     int bug_fdiv, bug_hlt, bug_f00f, bug_coma;
+
+    int online; /* offline threads are kept, but not counted */
 } x86_thread;
 
 struct x86_proc {
+    rpiz_arena *arena; /* owns the strings below */
+    rpiz_arena *derived; /* cpu_desc, all_flags and flag_sets, made again by each update */
+
     cpu_string_list *model_name;
     cpu_string_list *decoded_name;
     cpu_string_list *flags;
@@ -76,22 +81,35 @@ struct x86_proc {
     cpu_string_list *physical_id;
     cpu_string_list *core_id;
 
+    /* the known flags from x86_data.c come first, in table order,
+     * followed by any others found. bugs and pm flags are
+     * prefixed "bug:" and "pm:". ref_count is threads with flag */
     cpu_string_list *each_flag;
+    char *all_flags; /* each_flag joined, built when first asked for */
+    cpu_flag_sets flag_sets; /* over each_flag, per thread */
 
     char *cpu_name; /* do not free */
     char *cpu_desc;
     int max_khz;
+    cpufreq_sampler *freq;
 
     int thread_count;
-    x86_thread threads[MAX_THREADS];
-    int core_count;
+    x86_thread *threads;
+    int thread_alloc;
+    int core_count; /* from the topology, of online threads */
     int proc_count;
+    cpu_topology *topo;
+
+    const char *path; /* the cpuinfo read */
+    int host; /* path is this machine's, so sysfs applies */
+    char *online; /* /sys/devices/system/cpu/online as of the last update */
+    int generation;
 
     rpiz_fields *fields;
 };
 
-#define CHECK_FOR(k) (strncmp(k, key, (strlen(k) < strlen(key)) ? strlen(k) : strlen(key)) == 0)
-#define GET_STR(k, s) if (CHECK_FOR(k)) { p->threads[thread].s = strlist_add(p->s, value); continue; }
+#define GET_STR(k, s) case k: p->threads[thread].s = strlist_add_n(p->s, value.str, value.len); break;
+#define GET_YES(k, b) case k: if (value.len >= 3 && strncmp(value.str, "yes", 3) == 0) p->threads[thread].b = 1; break;
 #define FIN_PROC() if (thread >= 0) if (!p->threads[thread].model_name) { p->threads[thread].model_name = strlist_add(p->model_name, rep_pname); }
 
 #define REDUP(f) if(p->threads[di].f && !p->threads[i].f) { p->threads[i].f = strlist_add(p->f, p->threads[di].f); }
@@ -100,69 +118,106 @@ struct x86_proc {
 #define PROC_CPUINFO "/proc/cpuinfo"
 #endif
 
-static int scan_cpu(x86_proc* p) {
-    kv_scan *kv; char *key, *value;
-    int thread = -1;
+/* grow threads[] to hold at least n, doubling */
+static int reserve_threads(x86_proc *p, int n) {
+    x86_thread *tmp;
+    int na;
+    if (n <= p->thread_alloc) return 1;
+    na = (p->thread_alloc) ? p->thread_alloc * 2 : 8;
+    while (na < n) na *= 2;
+    tmp = realloc(p->threads, sizeof(x86_thread) * na);
+    if (!tmp) return 0;
+    p->threads = tmp;
+    p->thread_alloc = na;
+    return 1;
+}
+
+/* entries still referenced by an online thread */
+static int live_count(cpu_string_list *list) {
+    int i, n = 0;
+    for (i = 0; i < list->count; i++)
+        if (list->strs[i].ref_count > 0)
+            n++;
+    return n;
+}
+
+/* if only is given, just the threads in that cpu list that aren't
+ * already known are read, and added after the known ones */
+static int scan_cpu(x86_proc* p, const char *only) {
+    kv_scan *kv; kv_slice key, value;
+    cpuinfo_key ck;
+    int thread, first;
+    int skip = (only != NULL);
     int i, di;
     char rep_pname[256] = "";
     char tmp_maxfreq[128];
     char *tmp_str = NULL;
 
     if (!p) return 0;
+    first = p->thread_count;
+    thread = first - 1;
 
-    kv = kv_new_file(PROC_CPUINFO);
+    kv = kv_new_file(p->path);
     if (kv) {
-        while( kv_next(kv, &key, &value) ) {
-            if (CHECK_FOR("Processor")) {
-                strcpy(rep_pname, value);
-                continue;
-            }
-
-            if (CHECK_FOR("processor")) {
-                FIN_PROC();
-                thread++;
-                memset(&p->threads[thread], 0, sizeof(x86_thread));
-                p->threads[thread].id = atoi(value);
-                continue;
-            }
-
-            if (thread < 0) {
-                if ( CHECK_FOR("model name")
-                     || CHECK_FOR("flags") ) {
-                    /* this cpuinfo doesn't provide processor : n
-                     * there is prolly only one thread */
+        while( kv_next_slice(kv, &key, &value, KV_TRIM) ) {
+            ck = cpuinfo_key_lookup(key.str, key.len);
+            switch(ck) {
+                case CPUINFO_UNKNOWN:
+                    continue;
+                case CPUINFO_PROCESSOR_NAME:
+                    kv_slice_copy(&value, rep_pname, sizeof(rep_pname));
+                    continue;
+                case CPUINFO_PROCESSOR:
+                    FIN_PROC();
+                    if (only) {
+                        i = atoi(value.str);
+                        skip = !cpulist_has(only, i) || x86_proc_thread_from_id(p, i) >= 0;
+                        if (skip) continue;
+                    }
                     thread++;
+                    if (!reserve_threads(p, thread + 1)) {
+                        kv_free(kv);
+                        return 0;
+                    }
                     memset(&p->threads[thread], 0, sizeof(x86_thread));
-                    p->threads[thread].id = 0;
-                }
+                    p->threads[thread].id = atoi(value.str);
+                    p->threads[thread].online = 1;
+                    continue;
+                case CPUINFO_MODEL_NAME:
+                case CPUINFO_FLAGS:
+                    if (thread < 0) {
+                        /* this cpuinfo doesn't provide processor : n
+                         * there is prolly only one thread */
+                        thread++;
+                        if (!reserve_threads(p, thread + 1)) {
+                            kv_free(kv);
+                            return 0;
+                        }
+                        memset(&p->threads[thread], 0, sizeof(x86_thread));
+                        p->threads[thread].id = 0;
+                        p->threads[thread].online = 1;
+                    }
+                    break;
+                default:
+                    break;
             }
-            if (thread >= 0) {
-                GET_STR("model name", model_name);
-
-                GET_STR("physical id", physical_id);
-                GET_STR("core id", core_id);
-
-                GET_STR("flags", flags);
-                GET_STR("bugs", bug_flags);
-                GET_STR("power management", pm_flags);
-
-                if (CHECK_FOR("fdiv_bug") ) {
-                    if (strncmp(value, "yes", 3) == 0)
-                        p->threads[thread].bug_fdiv = 1;
-                }
-                if (CHECK_FOR("hlt_bug")) {
-                    if (strncmp(value, "yes", 3) == 0)
-                        p->threads[thread].bug_hlt = 1;
-                }
-                if (CHECK_FOR("f00f_bug")) {
-                    if (strncmp(value, "yes", 3) == 0)
-                        p->threads[thread].bug_f00f = 1;
-                }
-                if (CHECK_FOR("coma_bug")) {
-                    if (strncmp(value, "yes", 3) == 0)
-                        p->threads[thread].bug_coma = 1;
-                }
-
+            if (thread < 0 || skip) continue;
+            switch(ck) {
+                GET_STR(CPUINFO_MODEL_NAME, model_name);
+
+                GET_STR(CPUINFO_PHYSICAL_ID, physical_id);
+                GET_STR(CPUINFO_CORE_ID, core_id);
+
+                GET_STR(CPUINFO_FLAGS, flags);
+                GET_STR(CPUINFO_BUGS, bug_flags);
+                GET_STR(CPUINFO_POWER_MANAGEMENT, pm_flags);
+
+                GET_YES(CPUINFO_FDIV_BUG, bug_fdiv);
+                GET_YES(CPUINFO_HLT_BUG, bug_hlt);
+                GET_YES(CPUINFO_F00F_BUG, bug_f00f);
+                GET_YES(CPUINFO_COMA_BUG, bug_coma);
+                default:
+                    break;
             }
         }
         FIN_PROC();
@@ -174,7 +229,7 @@ static int scan_cpu(x86_proc* p) {
 
     /* re-duplicate missing data for /proc/cpuinfo variant that de-duplicated it */
     di = p->thread_count - 1;
-    for (i = di; i >= 0; i--) {
+    for (i = di; i >= first; i--) {
         if (p->threads[i].flags)
             di = i;
         else {
@@ -184,23 +239,23 @@ static int scan_cpu(x86_proc* p) {
         }
     }
 
-    /* thread/core stuff */
-    for (i = 0; i < p->thread_count; i++) {
-        if (p->threads[i].core_id)
-            p->threads[i].core = strtol(p->threads[i].core_id, NULL, 0);
-        else
-            p->threads[i].core = p->threads[i].id;
-
-        if (p->threads[i].physical_id)
-            p->threads[i].proc = strtol(p->threads[i].physical_id, NULL, 0);
+    /* thread/core stuff, counted in build_topology() */
+    for (i = first; i < p->thread_count; i++) {
+        p->threads[i].core = (p->threads[i].core_id) ? strtol(p->threads[i].core_id, NULL, 0) : -1;
+        p->threads[i].proc = (p->threads[i].physical_id) ? strtol(p->threads[i].physical_id, NULL, 0) : -1;
     }
-    p->core_count = p->core_id->count;
-    p->proc_count = p->physical_id->count;
-    if (!p->core_count) p->core_count = p->thread_count;
-    if (!p->proc_count) p->proc_count = p->thread_count;
+
+    /* cpufreq, one sampler for all threads */
+    p->freq = cpufreq_sampler_grow(p->freq, p->thread_count);
+    if (!p->freq)
+        return 0;
+    for (i = first; i < p->thread_count; i++)
+        p->freq->id[i] = p->threads[i].id;
+    if (p->host)
+        cpufreq_read_limits_from(p->freq, first);
 
     /* data not from /proc/cpuinfo */
-    for (i = 0; i < p->thread_count; i++) {
+    for (i = first; i < p->thread_count; i++) {
         if (p->threads[i].bug_flags == NULL) {
             /* make bugs list on old kernels that don't offer one */
             tmp_str = malloc(128);
@@ -230,123 +285,198 @@ static int scan_cpu(x86_proc* p) {
         free(tmp_str); tmp_str = NULL;
 
         /* freq */
-        get_cpu_freq(p->threads[i].id, &p->threads[i].cpukhz_min, &p->threads[i].cpukhz_max, &p->threads[i].cpukhz_cur);
-        sprintf(tmp_maxfreq, "%d", p->threads[i].cpukhz_max);
+        sprintf(tmp_maxfreq, "%d", p->freq->khz_max[i]);
         p->threads[i].cpukhz_max_str = strlist_add(p->cpukhz_max_str, tmp_maxfreq);
-        if (p->threads[i].cpukhz_max > p->max_khz)
-            p->max_khz = p->threads[i].cpukhz_max;
+        if (p->freq->khz_max[i] > p->max_khz)
+            p->max_khz = p->freq->khz_max[i];
     }
 
     return 1;
 }
 
+/* core ids repeat in each package, so cores are counted by
+ * (package, core) from sysfs, or cpuinfo's physical id and core id */
+static void build_topology(x86_proc *p) {
+    int i;
+    if (!p->topo)
+        p->topo = topology_new();
+    topology_clear(p->topo);
+    for (i = 0; i < p->thread_count; i++)
+        if (p->threads[i].online)
+            topology_add_cpu(p->topo, p->threads[i].id, p->threads[i].proc, p->threads[i].core);
+    topology_build(p->topo, p->host);
+    p->core_count = topology_count(p->topo, TOPO_CORE);
+    p->proc_count = topology_count(p->topo, TOPO_PACKAGE);
+}
+
+/* entries with no online threads left are skipped */
 static char *gen_cpu_desc(x86_proc *p) {
-    char *ret = NULL;
+    char ret[4096] = "";
     char tmp[1024];
-    int i, l = 0;
+    int i, n, l = 0;
     float maxfreq;
     if (p) {
-        ret = malloc(4096);
-        memset(ret, 0, 4096);
-        for (i = 0; i < p->model_name->count; i++) {
-            if (p->model_name->count > 1)
+        for (i = 0, n = 0; i < p->model_name->count; i++) {
+            if (p->model_name->strs[i].ref_count <= 0) continue;
+            if (live_count(p->model_name) > 1)
                 sprintf(tmp, "%dx %s", p->model_name->strs[i].ref_count, p->model_name->strs[i].str);
             else
                 sprintf(tmp, "%s", p->model_name->strs[i].str);
 
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
         sprintf(ret + l, "; "); l += 2;
-        for (i = 0; i < p->cpukhz_max_str->count; i++) {
+        for (i = 0, n = 0; i < p->cpukhz_max_str->count; i++) {
+            if (p->cpukhz_max_str->strs[i].ref_count <= 0) continue;
             maxfreq = atof(p->cpukhz_max_str->strs[i].str);
             if (maxfreq)
                 maxfreq /= 1000;
             else
                 maxfreq = 0.0f;
             sprintf(tmp, "%dx %0.2f MHz", p->cpukhz_max_str->strs[i].ref_count, maxfreq);
-            sprintf(ret + l, "%s%s", (i>0) ? " + " : "", tmp);
-            l += (i>0) ? strlen(tmp) + 3 : strlen(tmp);
+            sprintf(ret + l, "%s%s", (n>0) ? " + " : "", tmp);
+            l += (n>0) ? strlen(tmp) + 3 : strlen(tmp);
+            n++;
         }
     }
-    return ret;
+    return (p) ? arena_strdup(p->derived, ret) : NULL;
 }
 
-#define APPEND_FLAG(f) strcat(all_flags, f); strcat(all_flags, " ");
-static void process_flags(x86_proc *s) {
+/* add weight to each flag of a flags string, named with prefix.
+ * each_flag is the set of known flags, returns how many weren't in it */
+static int add_flags(x86_proc *s, const char *prefix, const char *flags, int weight) {
     char flag[32] = "";
-    char *all_flags; /* x86_data.c: static char all_flags[4096] */
-    char *cur, *next;
+    const char *w;
+    int len, before, plen = strlen(prefix);
+    if (!s || !flags) return 0;
+
+    before = s->each_flag->count;
+    while ((len = str_next_word(&flags, &w))) {
+        if (plen + len > 31) continue;
+        snprintf(flag, sizeof(flag), "%s%.*s", prefix, len, w);
+        strlist_add_w(s->each_flag, flag, weight);
+    }
+    if (s->each_flag->count != before)
+        s->all_flags = NULL;
+    return s->each_flag->count - before;
+}
+
+static void thread_flags(x86_proc *s, int i, int weight) {
+    add_flags(s, "", s->threads[i].flags, weight);
+    add_flags(s, "bug:", s->threads[i].bug_flags, weight);
+    add_flags(s, "pm:", s->threads[i].pm_flags, weight);
+}
+
+static void process_flags(x86_proc *s) {
     int added_count = 0, i, si;
     if (!s) return;
 
     cpu_string_list *sets[3] = { s->flags, s->bug_flags, s->pm_flags };
     char *prefix[3] = { "", "bug:", "pm:" };
-    int plen = 0, flen = 0;
-
-    all_flags = (char*)x86_flag_list();
-
-    for(si = 0; si < 3; si++) {
-        plen = strlen(prefix[si]);
-        for(i = 0; i < sets[si]->count; i++) {
-            if (sets[si]->strs[i].str) {
-                cur = sets[si]->strs[i].str;
-                next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-                while(next) {
-                    flen = next-cur;
-                    if (flen <= (31 - plen) ) {
-                        memset(flag, 0, 32);
-                        snprintf(flag, plen + flen + 1, "%s%s", prefix[si], cur);
-                        if (strlen(flag) > (unsigned int)plen) {
-                            /* add it to the string list, copy the flag string's ref_count */
-                            strlist_add_w(s->each_flag, flag, sets[si]->strs[i].ref_count);
-
-                            /* add it to the list of known all flags, if it isn't there */
-                            if (!search_for_flag(all_flags, flag)) {
-                                APPEND_FLAG(flag);
-                                added_count++;
-                            }
-                        }
-                    }
-                    if (*next == '\0') break;
-                    cur = next + 1;
-                    next = strchr(cur, ' '); if (!next) next = strchr(cur, '\0');
-                }
-            }
-        }
+    const char *name;
+
+    for (i = 0; (name = x86_flag_name(i)); i++)
+        strlist_add_w(s->each_flag, name, 0);
+
+    for(si = 0; si < 3; si++)
+        for(i = 0; i < sets[si]->count; i++)
+            added_count += add_flags(s, prefix[si], sets[si]->strs[i].str, sets[si]->strs[i].ref_count);
+    //DEBUG printf("process_flags(): added %d previously unknown flags\n", added_count);
+}
+
+#define REWEIGHT(f) if (t->f) strlist_add_w(s->f, t->f, weight);
+/* add weight to the ref_count of everything thread i points at */
+static void thread_weight(x86_proc *s, int i, int weight) {
+    x86_thread *t = &s->threads[i];
+    REWEIGHT(model_name);
+    REWEIGHT(decoded_name);
+    REWEIGHT(flags);
+    REWEIGHT(bug_flags);
+    REWEIGHT(pm_flags);
+    REWEIGHT(cpukhz_max_str);
+    REWEIGHT(physical_id);
+    REWEIGHT(core_id);
+    thread_flags(s, i, weight);
+}
+
+/* each thread's flags, bugs and pm flags as a set over each_flag,
+ * threads with the same strings share one */
+static void build_flag_sets(x86_proc *s) {
+    static const char *prefix[3] = { NULL, "bug:", "pm:" };
+    const char **flags;
+    uint64_t *online;
+    x86_thread *t;
+    int i;
+    if (!s) return;
+
+    flags = arena_alloc(s->derived, sizeof(char*) * (s->thread_count * 3 + 1));
+    online = flagset_new(s->derived, FLAGSET_WORDS(s->thread_count));
+    if (!flags || !online) return;
+    for (i = 0; i < s->thread_count; i++) {
+        t = &s->threads[i];
+        flags[i * 3] = t->flags;
+        flags[i * 3 + 1] = t->bug_flags;
+        flags[i * 3 + 2] = t->pm_flags;
+        if (t->online)
+            flagset_set(online, i);
     }
-    //DEBUG printf("process_flags(): added %d previously unknown flags\n(%d): %s\n", added_count, (int)strlen(all_flags), all_flags );
+    flag_sets_build(&s->flag_sets, s->derived, s->thread_count, flags, prefix, 3, online, s->each_flag);
+}
+
+static char *gen_cpu_name(x86_proc *s) {
+    int i;
+    if (live_count(s->model_name) == 1)
+        for (i = 0; i < s->model_name->count; i++)
+            if (s->model_name->strs[i].ref_count > 0)
+                return s->model_name->strs[i].str;
+    return (char *)unk;
 }
 
 x86_proc *x86_proc_new(void) {
-    x86_proc *s = malloc( sizeof(x86_proc) );
+    return x86_proc_new_file(PROC_CPUINFO);
+}
+
+/* a cpuinfo dump from any machine, sysfs is only read
+ * when it is this machine's own cpuinfo */
+x86_proc *x86_proc_new_file(const char *path) {
+    x86_proc *s;
+    if (!path) return NULL;
+    s = malloc( sizeof(x86_proc) );
     if (s) {
         memset(s, 0, sizeof(*s));
-        s->model_name = strlist_new();
-        s->decoded_name = strlist_new();
-        s->flags = strlist_new();
-        s->bug_flags = strlist_new();
-        s->pm_flags = strlist_new();
-        s->cpukhz_max_str = strlist_new();
-        s->core_id = strlist_new();
-        s->physical_id = strlist_new();
-        s->each_flag = strlist_new();
-        if (!scan_cpu(s)) {
+        s->arena = arena_new();
+        s->derived = arena_new();
+        s->path = arena_strdup(s->arena, path);
+        s->host = (strcmp(path, PROC_CPUINFO) == 0);
+        s->model_name = strlist_new_arena(s->arena);
+        s->decoded_name = strlist_new_arena(s->arena);
+        s->flags = strlist_new_arena(s->arena);
+        s->bug_flags = strlist_new_arena(s->arena);
+        s->pm_flags = strlist_new_arena(s->arena);
+        s->cpukhz_max_str = strlist_new_arena(s->arena);
+        s->core_id = strlist_new_arena(s->arena);
+        s->physical_id = strlist_new_arena(s->arena);
+        s->each_flag = strlist_new_arena(s->arena);
+        if (!scan_cpu(s, NULL)) {
             x86_proc_free(s);
             return NULL;
         }
+        build_topology(s);
         s->cpu_desc = gen_cpu_desc(s);
-        if (s->model_name->count == 1)
-            s->cpu_name = s->model_name->strs[0].str;
-        else
-            s->cpu_name = (char *)unk;
+        s->cpu_name = gen_cpu_name(s);
         process_flags(s);
+        build_flag_sets(s);
+        if (s->host)
+            s->online = cpu_online_list();
     }
     return s;
 }
 
 void x86_proc_free(x86_proc *s) {
     if(s) {
+        fields_detach(s->fields);
         strlist_free(s->model_name);
         strlist_free(s->decoded_name);
         strlist_free(s->flags);
@@ -356,8 +486,13 @@ void x86_proc_free(x86_proc *s) {
         strlist_free(s->core_id);
         strlist_free(s->physical_id);
         strlist_free(s->each_flag);
+        cpufreq_sampler_free(s->freq);
         fields_free(s->fields);
-        free(s->cpu_desc);
+        topology_free(s->topo);
+        free(s->threads);
+        free(s->online);
+        arena_free(s->arena);
+        arena_free(s->derived);
         free(s);
     }
 }
@@ -376,18 +511,45 @@ const char *x86_proc_desc(x86_proc *s) {
         return NULL;
 }
 
+/* known flags in table order, then any others found */
+const char *x86_proc_all_flags(x86_proc *s) {
+    if (!s) return NULL;
+    if (!s->all_flags)
+        s->all_flags = strlist_join(s->derived, s->each_flag);
+    return s->all_flags;
+}
+
 int x86_proc_has_flag(x86_proc *s, const char *flag) {
-    int i;
+    cpu_string *cs;
     if (s && flag) {
-        for (i = 0; i < s->each_flag->count; i++) {
-            //DEBUG printf("(%s)...[%d/%d] %s %d\n", flag, i, s->each_flag->count, s->each_flag->strs[i].str, s->each_flag->strs[i].ref_count);
-            if (strcmp(s->each_flag->strs[i].str, flag) == 0)
-                return s->each_flag->strs[i].ref_count;
-        }
+        cs = strlist_find(s->each_flag, flag);
+        if (cs)
+            return cs->ref_count;
     }
     return 0;
 }
 
+int x86_proc_thread_has_flag(x86_proc *s, int thread, const char *flag) {
+    int bit;
+    if (s && flag && thread >= 0 && thread < s->flag_sets.count) {
+        bit = strlist_pos(s->each_flag, flag);
+        if (bit >= 0)
+            return flagset_test(s->flag_sets.set[thread], bit);
+    }
+    return 0;
+}
+
+int x86_proc_thread_flag_count(x86_proc *s, int thread) {
+    if (s && thread >= 0 && thread < s->flag_sets.count)
+        return flagset_count(s->flag_sets.set[thread], s->flag_sets.words);
+    return 0;
+}
+
+/* flags some online threads have but not all */
+const char *x86_proc_uncommon_flags(x86_proc *s) {
+    return (s) ? s->flag_sets.uncommon : NULL;
+}
+
 int x86_proc_threads(x86_proc *s) {
     if (s)
         return s->thread_count;
@@ -395,6 +557,22 @@ int x86_proc_threads(x86_proc *s) {
         return 0;
 }
 
+int x86_proc_threads_online(x86_proc *s) {
+    int i, n = 0;
+    if (s)
+        for (i = 0; i < s->thread_count; i++)
+            n += !!s->threads[i].online;
+    return n;
+}
+
+int x86_proc_thread_online(x86_proc *s, int thread) {
+    if (s)
+        if (thread >= 0 && thread < s->thread_count)
+            return s->threads[thread].online;
+
+    return 0;
+}
+
 int x86_proc_cores(x86_proc *s) {
     if (s)
         return s->core_count;
@@ -409,6 +587,13 @@ int x86_proc_count(x86_proc *s) {
         return 0;
 }
 
+cpu_topology *x86_proc_topology(x86_proc *s) {
+    if (s)
+        return s->topo;
+    else
+        return NULL;
+}
+
 int x86_proc_thread_from_id(x86_proc *s, int id) {
     int i = 0;
     if (s)
@@ -430,7 +615,7 @@ int x86_proc_thread_id(x86_proc *s, int thread) {
 int x86_proc_thread_khz_min(x86_proc *s, int thread) {
     if (s)
         if (thread >= 0 && thread < s->thread_count)
-            return s->threads[thread].cpukhz_min;
+            return s->freq->khz_min[thread];
 
     return 0;
 }
@@ -438,53 +623,101 @@ int x86_proc_thread_khz_min(x86_proc *s, int thread) {
 int x86_proc_thread_khz_max(x86_proc *s, int thread) {
     if (s)
         if (thread >= 0 && thread < s->thread_count)
-            return s->threads[thread].cpukhz_max;
+            return s->freq->khz_max[thread];
 
     return 0;
 }
 
 int x86_proc_thread_khz_cur(x86_proc *s, int thread) {
     if (s)
-        if (thread >= 0 && thread < s->thread_count) {
-            get_cpu_freq(s->threads[thread].id, NULL, NULL, &s->threads[thread].cpukhz_cur);
-            return s->threads[thread].cpukhz_cur;
-        }
+        if (thread >= 0 && thread < s->thread_count)
+            return s->freq->khz_cur[thread];
+
     return 0;
 }
 
-static char* x86_proc_threads_str(x86_proc *s) {
-    char *buff = NULL;
-    if (s) {
-        buff = malloc(128);
-        if (buff)
-            snprintf(buff, 127, "%d", x86_proc_threads(s) );
-    }
-    return buff;
+/* refresh the khz_cur snapshot of every thread in one pass */
+int x86_proc_freq_sample(x86_proc *s) {
+    if (s && s->host)
+        return cpufreq_sample(s->freq);
+    return 0;
 }
 
-static char* x86_proc_cores_str(x86_proc *s) {
-    char *buff = NULL;
-    if (s) {
-        buff = malloc(128);
-        if (buff)
-            snprintf(buff, 127, "%d", x86_proc_cores(s) );
-    }
-    return buff;
+static double x86_proc_threads_num(x86_proc *s, int i) {
+    i = i; /* avoid a warning */
+    return x86_proc_threads_online(s);
 }
 
-static char* x86_proc_count_str(x86_proc *s) {
-    char *buff = NULL;
-    if (s) {
-        buff = malloc(128);
-        if (buff)
-            snprintf(buff, 127, "%d", x86_proc_count(s) );
-    }
-    return buff;
+static double x86_proc_cores_num(x86_proc *s, int i) {
+    i = i; /* avoid a warning */
+    return x86_proc_cores(s);
+}
+
+static double x86_proc_count_num(x86_proc *s, int i) {
+    i = i; /* avoid a warning */
+    return x86_proc_count(s);
+}
+
+static const char *x86_proc_topology_str(x86_proc *s) {
+    return topology_summary(x86_proc_topology(s));
 }
 
 #define ADDFIELD(t, l, o, n, f) fields_update_bytag(s->fields, t, l, o, n, (rpiz_fields_get_func)f, (void*)s)
 #define ADDFIELDSTR(t, l, o, n, str) fields_update_bytag(s->fields, t, l, o, n, NULL, (void*)str)
+#define ADDFIELDNUM(t, l, n, f, sc, d, u) fields_update_bytag_num(s->fields, t, l, n, (rpiz_fields_get_num_func)f, (void*)s, 0, sc, d, u)
+/* per-thread fields, made only when read */
+enum {
+    TF_MODEL_NAME, TF_PHYSICAL_ID, TF_CORE_ID, TF_TOPOLOGY, TF_BUGS,
+    TF_N
+};
+
+static const rpiz_field_def thread_fields[TF_N] = {
+    { "model_name",  "linux name",  0, NULL },
+    { "physical_id", "physical id", 0, NULL },
+    { "core_id",     "core id",     0, NULL },
+    { "topology",    "topology",    0, NULL },
+    { "bugs",        "bugs",        0, NULL },
+};
+
+#define STR_OR_EMPTY(s) ((s) ? (s) : "")
+/* index is thread * TF_N + field */
+static char *thread_field(x86_proc *s, int index) {
+    x86_thread *t = &s->threads[index / TF_N];
+    char buff[256] = "";
+    switch (index % TF_N) {
+        case TF_MODEL_NAME:
+            snprintf(buff, 256, "%s", STR_OR_EMPTY(t->model_name)); break;
+        case TF_PHYSICAL_ID:
+            snprintf(buff, 256, "%s", STR_OR_EMPTY(t->physical_id)); break;
+        case TF_CORE_ID:
+            snprintf(buff, 256, "%s", STR_OR_EMPTY(t->core_id)); break;
+        case TF_TOPOLOGY:
+            topology_cpu_str(s->topo, t->id, buff, 256); break;
+        case TF_BUGS:
+            snprintf(buff, 256, "%s", STR_OR_EMPTY(t->bug_flags)); break;
+    }
+    return strdup(buff);
+}
+
+/* fields for thread i, s->fields must already exist */
+static void add_thread_fields(x86_proc *s, int i) {
+    fields_add_table_at(s->fields, "cpu.thread", i, s->threads[i].id, thread_fields, TF_N,
+        (rpiz_fields_get_at_func)thread_field, NULL, (void*)s);
+}
+
+/* build_topology() may have renumbered the threads, so each
+ * topology field read before is made again */
+static void expire_topology_fields(x86_proc *s, int count) {
+    char bt[256] = "";
+    int i;
+    for (i = 0; i < count; i++) {
+        sprintf(bt, "cpu.thread[%d].%s", i, thread_fields[TF_TOPOLOGY].tag);
+        fields_expire_bytag(s->fields, bt);
+    }
+}
+
 rpiz_fields *x86_proc_fields(x86_proc *s) {
+    int i;
     if (s) {
         if (!s->fields) {
             /* first insert creates */
@@ -492,11 +725,73 @@ rpiz_fields *x86_proc_fields(x86_proc *s) {
             ADDFIELD("summary.proc_desc",  0, 0, "Proccesor", x86_proc_desc );
             ADDFIELD("cpu.name",           0, 0, "Proccesor Name", x86_proc_name );
             ADDFIELD("cpu.desc",           0, 0, "Proccesor Description", x86_proc_desc );
-            ADDFIELD("cpu.physical_count", 0, 1, "Count", x86_proc_count_str );
-            ADDFIELD("cpu.core_count",     0, 1, "Cores", x86_proc_cores_str );
-            ADDFIELD("cpu.count",          0, 1, "Threads", x86_proc_threads_str );
+            ADDFIELDNUM("cpu.physical_count", 0, "Count", x86_proc_count_num, 1, 0, NULL );
+            ADDFIELDNUM("cpu.core_count",  0, "Cores", x86_proc_cores_num, 1, 0, NULL );
+            ADDFIELDNUM("cpu.count",       0, "Threads", x86_proc_threads_num, 1, 0, NULL );
+            ADDFIELD("cpu.topology",       0, 0, "Topology", x86_proc_topology_str );
+
+            for(i = 0; i < s->thread_count; i++)
+                add_thread_fields(s, i);
         }
         return s->fields;
     }
     return NULL;
 }
+
+/* compare the kernel's online cpu list with the last one seen,
+ * threads going offline are kept but no longer counted, and only
+ * threads not seen before are read from /proc/cpuinfo.
+ * returns 1 if anything changed. */
+int x86_proc_update(x86_proc *s) {
+    char *online;
+    int i, known, first, on;
+    if (!s || !s->host) return 0;
+
+    online = cpu_online_list();
+    if (!online) return 0;
+    if (s->online && strcmp(online, s->online) == 0) {
+        free(online);
+        return 0;
+    }
+
+    for (i = 0, known = 0; i < s->thread_count; i++) {
+        on = cpulist_has(online, s->threads[i].id);
+        if (on != s->threads[i].online) {
+            thread_weight(s, i, on ? 1 : -1);
+            s->threads[i].online = on;
+        }
+        known += on;
+    }
+
+    first = s->thread_count;
+    if (cpulist_count(online) > known) {
+        scan_cpu(s, online);
+        for (i = first; i < s->thread_count; i++)
+            thread_flags(s, i, 1);
+    }
+    build_topology(s);
+
+    /* made from the threads again, in the memory of the last ones */
+    arena_reset(s->derived);
+    s->all_flags = NULL;
+    build_flag_sets(s);
+    s->cpu_desc = gen_cpu_desc(s);
+    s->cpu_name = gen_cpu_name(s);
+    if (s->fields) {
+        expire_topology_fields(s, first);
+        for (i = first; i < s->thread_count; i++)
+            add_thread_fields(s, i);
+    }
+
+    free(s->online);
+    s->online = online;
+    s->generation++;
+    live_cache_flush();
+    return 1;
+}
+
+int x86_proc_generation(x86_proc *s) {
+    if (s)
+        return s->generation;
+    return 0;
+}
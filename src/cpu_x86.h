@@ -24,26 +24,38 @@
 #include "fields.h"
 
 #include "x86_data.h"
+#include "topology.h"
 const char *x86_flag_list(void);
 
 typedef struct x86_proc x86_proc;
 
 x86_proc *x86_proc_new(void);
+x86_proc *x86_proc_new_file(const char *path); /* any machine's cpuinfo */
 void x86_proc_free(x86_proc *);
 
 const char *x86_proc_name(x86_proc *);
 const char *x86_proc_desc(x86_proc *);
+const char *x86_proc_all_flags(x86_proc *);
 int x86_proc_has_flag(x86_proc *, const char *flag); /* returns core count with flag */
+int x86_proc_thread_has_flag(x86_proc *, int thread, const char *flag);
+int x86_proc_thread_flag_count(x86_proc *, int thread);
+const char *x86_proc_uncommon_flags(x86_proc *); /* flags not on every thread */
 int x86_proc_count(x86_proc *);
 int x86_proc_cores(x86_proc *);
-int x86_proc_threads(x86_proc *);
+int x86_proc_threads(x86_proc *); /* includes threads gone offline */
+int x86_proc_threads_online(x86_proc *);
+int x86_proc_thread_online(x86_proc *, int thread);
 
+cpu_topology *x86_proc_topology(x86_proc *);
 int x86_proc_thread_from_id(x86_proc *, int id); /* -1 if not found */
 int x86_proc_thread_id(x86_proc *, int thread);
 
 int x86_proc_thread_khz_min(x86_proc *, int thread);
 int x86_proc_thread_khz_max(x86_proc *, int thread);
-int x86_proc_thread_khz_cur(x86_proc *, int thread);
+int x86_proc_thread_khz_cur(x86_proc *, int thread); /* from the last x86_proc_freq_sample() */
+int x86_proc_freq_sample(x86_proc *);
+int x86_proc_update(x86_proc *); /* rescan after hotplug, 1 if changed */
+int x86_proc_generation(x86_proc *); /* bumped by each change */
 
 rpiz_fields *x86_proc_fields(x86_proc *);
 
@@ -0,0 +1,94 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include <string.h>
+#include "cpuinfo.h"
+
+#define KEY_IS(k, e) if (memcmp(key, k, sizeof(k) - 1) == 0) return e;
+
+/* switch on length, then first character, then one compare */
+cpuinfo_key cpuinfo_key_lookup(const char *key, int len) {
+    if (!key) return CPUINFO_UNKNOWN;
+    switch(len) {
+        case 3:
+            KEY_IS("isa", CPUINFO_ISA);
+            break;
+        case 4:
+            switch(key[0]) {
+                case 'h': KEY_IS("hart", CPUINFO_HART); break;
+                case 'b': KEY_IS("bugs", CPUINFO_BUGS); break;
+            }
+            break;
+        case 5:
+            KEY_IS("flags", CPUINFO_FLAGS);
+            break;
+        case 6:
+            KEY_IS("Serial", CPUINFO_SERIAL);
+            break;
+        case 7:
+            switch(key[0]) {
+                case 'c': KEY_IS("core id", CPUINFO_CORE_ID); break;
+                case 'h': KEY_IS("hlt_bug", CPUINFO_HLT_BUG); break;
+            }
+            break;
+        case 8:
+            switch(key[0]) {
+                case 'F': KEY_IS("Features", CPUINFO_FEATURES); break;
+                case 'H': KEY_IS("Hardware", CPUINFO_HARDWARE); break;
+                case 'R': KEY_IS("Revision", CPUINFO_REVISION); break;
+                case 'C': KEY_IS("CPU part", CPUINFO_CPU_PART); break;
+                case 'f':
+                    KEY_IS("fdiv_bug", CPUINFO_FDIV_BUG);
+                    KEY_IS("f00f_bug", CPUINFO_F00F_BUG);
+                    break;
+                case 'c': KEY_IS("coma_bug", CPUINFO_COMA_BUG); break;
+            }
+            break;
+        case 9:
+            switch(key[0]) {
+                case 'p': KEY_IS("processor", CPUINFO_PROCESSOR); break;
+                case 'P': KEY_IS("Processor", CPUINFO_PROCESSOR_NAME); break;
+                case 'v': KEY_IS("vendor_id", CPUINFO_VENDOR_ID); break;
+            }
+            break;
+        case 10:
+            KEY_IS("model name", CPUINFO_MODEL_NAME);
+            break;
+        case 11:
+            switch(key[0]) {
+                case 'p': KEY_IS("physical id", CPUINFO_PHYSICAL_ID); break;
+                case 'C': KEY_IS("CPU variant", CPUINFO_CPU_VARIANT); break;
+            }
+            break;
+        case 12:
+            KEY_IS("CPU revision", CPUINFO_CPU_REVISION);
+            break;
+        case 15:
+            KEY_IS("CPU implementer", CPUINFO_CPU_IMPLEMENTER);
+            break;
+        case 16:
+            switch(key[0]) {
+                case 'C': KEY_IS("CPU architecture", CPUINFO_CPU_ARCHITECTURE); break;
+                case 'p': KEY_IS("power management", CPUINFO_POWER_MANAGEMENT); break;
+            }
+            break;
+    }
+    return CPUINFO_UNKNOWN;
+}
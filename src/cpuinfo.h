@@ -0,0 +1,61 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _CPUINFO_H_
+#define _CPUINFO_H_
+
+/* keys from /proc/cpuinfo that any backend looks at */
+typedef enum {
+    CPUINFO_UNKNOWN = 0,
+    CPUINFO_PROCESSOR,          /* "processor", logical cpu number */
+    CPUINFO_PROCESSOR_NAME,     /* "Processor", older arm kernels */
+    CPUINFO_HARDWARE,
+    CPUINFO_MODEL_NAME,
+    CPUINFO_FEATURES,
+    CPUINFO_FLAGS,
+    /* arm */
+    CPUINFO_CPU_IMPLEMENTER,
+    CPUINFO_CPU_ARCHITECTURE,
+    CPUINFO_CPU_VARIANT,
+    CPUINFO_CPU_PART,
+    CPUINFO_CPU_REVISION,
+    /* x86 */
+    CPUINFO_VENDOR_ID,
+    CPUINFO_PHYSICAL_ID,
+    CPUINFO_CORE_ID,
+    CPUINFO_BUGS,
+    CPUINFO_POWER_MANAGEMENT,
+    CPUINFO_FDIV_BUG,
+    CPUINFO_HLT_BUG,
+    CPUINFO_F00F_BUG,
+    CPUINFO_COMA_BUG,
+    /* riscv */
+    CPUINFO_HART,
+    CPUINFO_ISA,
+    /* rpi */
+    CPUINFO_REVISION,
+    CPUINFO_SERIAL,
+    CPUINFO_N_KEYS,
+} cpuinfo_key;
+
+/* exact match of a trimmed key (see KV_TRIM), len need not be terminated */
+cpuinfo_key cpuinfo_key_lookup(const char *key, int len);
+
+#endif
@@ -17,214 +17,646 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  *
  */
-
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "util.h"
 #include "fields.h"
 
-struct rpiz_fields {
+typedef struct {
     int live;
-    int own_value;
-    char *tag;
+    int own_value; /* get_func returns a new string */
     char *name;
     char *value;
+    int value_owned; /* value is to be freed with the field */
+    int changed; /* generation of the last change of value */
     void *data;
     rpiz_fields_get_func get_func;
-    rpiz_fields *next;
+    rpiz_fields_get_at_func get_at_func;
+    rpiz_fields_get_num_func get_num_func;
+    int index;
+    double num; /* as read, shown as num * scale */
+    double scale;
+    int decimals;
+    const char *unit;
+    int num_read;
+    int num_shown; /* value is num, formatted */
+    int expired; /* made by get_at_func, but to be made again */
+    int period_ms; /* live only, how often it is worth reading */
+    double sampled; /* monotonic_seconds() of the last read */
+} rpiz_field;
+
+/* field i is items[i], its tag is tags->strs[i].str, and
+ * the tags list's hash finds a tag's i. A view has no fields
+ * of its own, field i is found in its parts in turn */
+struct rpiz_fields {
+    cpu_string_list *tags;
+    rpiz_field *items;
+    int alloc;
+    int generation; /* of the last value to change */
+    rpiz_fields **parts;
+    int part_count;
+    int refs;
 };
 
+/* generations are from one clock, so a view's parts compare.
+ * Lists on other threads tick it too */
+static int fields_clock;
+
+static int fields_tick(void) {
+    return __atomic_add_fetch(&fields_clock, 1, __ATOMIC_RELAXED);
+}
+
 rpiz_fields *fields_new() {
     rpiz_fields *s = malloc(sizeof(rpiz_fields));
     if (s) {
         memset(s, 0, sizeof(*s));
+        s->refs = 1;
+        s->tags = strlist_new();
+        if (!s->tags) {
+            free(s);
+            return NULL;
+        }
     }
     return s;
 }
 
+rpiz_fields *fields_view_new(rpiz_fields **parts, int count) {
+    rpiz_fields *s = fields_new();
+    int i;
+    if (!s) return NULL;
+    s->parts = malloc(sizeof(rpiz_fields*) * (count + 1));
+    if (!s->parts) {
+        fields_free(s);
+        return NULL;
+    }
+    for (i = 0; i < count; i++)
+        if (parts[i])
+            s->parts[s->part_count++] = fields_ref(parts[i]);
+    return s;
+}
+
+rpiz_fields *fields_ref(rpiz_fields *s) {
+    if (s)
+        s->refs++;
+    return s;
+}
+
 void fields_free(rpiz_fields *s) {
+    int i;
     if (s) {
-        if (s->next != NULL)
-            fields_free(s->next);
-        free(s->tag);
-        free(s->name);
-        if (s->own_value)
-            free(s->value);
+        if (--s->refs > 0)
+            return;
+        for (i = 0; i < s->part_count; i++)
+            fields_free(s->parts[i]);
+        free(s->parts);
+        for (i = 0; i < s->tags->count; i++) {
+            free(s->items[i].name);
+            if (s->items[i].value_owned)
+                free(s->items[i].value);
+        }
+        free(s->items);
+        strlist_free(s->tags);
         free(s);
     }
 }
 
-rpiz_fields *fields_copy(rpiz_fields *src, rpiz_fields *append_src) {
-    rpiz_fields *dest = NULL, *prev = NULL, *cpd = NULL;
-    while (src) {
-        cpd = malloc(sizeof(rpiz_fields));
-        if (!cpd) {
-            fields_free(dest);
-            return NULL;
+int fields_count(rpiz_fields *s) {
+    int p, n;
+    if (!s) return 0;
+    if (!s->parts)
+        return s->tags->count;
+    for (p = 0, n = 0; p < s->part_count; p++)
+        n += fields_count(s->parts[p]);
+    return n;
+}
+
+int fields_find(rpiz_fields *s, const char *tag) {
+    int p, i, off = 0;
+    if (!s || !tag) return -1;
+    if (!s->parts)
+        return strlist_pos(s->tags, tag);
+    for (p = 0; p < s->part_count; p++) {
+        i = fields_find(s->parts[p], tag);
+        if (i >= 0)
+            return off + i;
+        off += fields_count(s->parts[p]);
+    }
+    return -1;
+}
+
+/* field i, or NULL. For a view, s and i are made the part
+ * that holds it and its index there */
+static rpiz_field *fields_at(rpiz_fields **s, int *i) {
+    rpiz_fields *l = *s;
+    int p, n;
+    if (!l || *i < 0) return NULL;
+    while (l->parts) {
+        for (p = 0; p < l->part_count; p++) {
+            n = fields_count(l->parts[p]);
+            if (*i < n) break;
+            *i -= n;
         }
-        memset(cpd, 0, sizeof(*cpd));
-        if (!dest)
-            dest = cpd;
-        if (prev)
-            prev->next = cpd;
-
-        cpd->own_value = src->own_value;
-        cpd->live = src->live;
-        cpd->get_func = src->get_func;
-        cpd->data = src->data;
-        cpd->tag = strdup(src->tag);
-        cpd->name = strdup(src->name);
-        if (cpd->own_value)
-            cpd->value = strdup(src->value);
-        else
-            cpd->value = src->value;
+        if (p == l->part_count) return NULL;
+        l = l->parts[p];
+    }
+    if (*i >= l->tags->count) return NULL;
+    *s = l;
+    return &l->items[*i];
+}
+
+/* a new field at the end, or NULL */
+static rpiz_field *fields_append(rpiz_fields *s, const char *tag) {
+    rpiz_field *tmp;
+    int na;
+    if (s->tags->count == s->alloc) {
+        na = (s->alloc) ? s->alloc * 2 : 32;
+        tmp = realloc(s->items, sizeof(rpiz_field) * na);
+        if (!tmp) return NULL;
+        s->items = tmp;
+        s->alloc = na;
+    }
+    if (!strlist_add(s->tags, tag))
+        return NULL;
+    tmp = &s->items[s->tags->count - 1];
+    memset(tmp, 0, sizeof(*tmp));
+    return tmp;
+}
 
-        prev = cpd;
-        src = src->next;
-        if (!src && append_src) {
+rpiz_fields *fields_copy(rpiz_fields *src, rpiz_fields *append_src) {
+    rpiz_fields *dest, *l;
+    rpiz_field *f, *cpd;
+    int i, j;
+    if (!src && !append_src) return NULL;
+    dest = fields_new();
+    if (!dest) return NULL;
+    while (src || append_src) {
+        if (!src) {
             /* append another fields list if given */
             src = append_src;
             append_src = NULL;
         }
+        for (i = 0; i < fields_count(src); i++) {
+            l = src;
+            j = i;
+            f = fields_at(&l, &j);
+            cpd = fields_append(dest, l->tags->strs[j].str);
+            if (!cpd) {
+                fields_free(dest);
+                return NULL;
+            }
+            *cpd = *f;
+            cpd->name = (f->name) ? strdup(f->name) : NULL;
+            if (cpd->value_owned)
+                cpd->value = (f->value) ? strdup(f->value) : NULL;
+            if (cpd->changed > dest->generation)
+                dest->generation = cpd->changed;
+        }
+        src = NULL;
     }
     return dest;
 }
 
-
-int fields_tag_has_prefix(rpiz_fields *s, const char *prefix) {
-    int tl = 0, pl = 0;
-    if (s && prefix) {
-        pl = strlen(prefix);
-        if (s->tag)
-            tl = strlen(s->tag);
-        if (tl && tl >= pl)
-            if (strncmp(s->tag, prefix, pl) == 0)
-                return 1;
+int fields_next_with_tag_prefix(rpiz_fields *s, int from, const char *prefix) {
+    int i, pl, p, n, off = 0;
+    if (!s) return -1;
+    if (from < 0) from = 0;
+    if (s->parts) {
+        for (p = 0; p < s->part_count; p++) {
+            n = fields_count(s->parts[p]);
+            if (from < off + n) {
+                i = fields_next_with_tag_prefix(s->parts[p], from - off, prefix);
+                if (i >= 0)
+                    return off + i;
+            }
+            off += n;
+        }
+        return -1;
     }
-    return 0;
+    if (!prefix)
+        return (from < s->tags->count) ? from : -1;
+    pl = strlen(prefix);
+    for (i = from; i < s->tags->count; i++)
+        if (strncmp(s->tags->strs[i].str, prefix, pl) == 0)
+            return i;
+    return -1;
 }
 
-rpiz_fields *fields_next(rpiz_fields *s) {
-    if (s)
-        return s->next;
-    else
-        return NULL;
+static int str_same(const char *a, const char *b) {
+    if (a && b)
+        return strcmp(a, b) == 0;
+    return a == b;
 }
 
-rpiz_fields *fields_next_with_tag_prefix(rpiz_fields *s, const char *prefix) {
-    if (s)
-        s = s->next;
-    while(s) {
-        if ( fields_tag_has_prefix(s, prefix) )
-            return s;
-        s = s->next;
+/* value replaces the field's, and is the field's to free if owned */
+static void fields_set_value(rpiz_fields *s, rpiz_field *f, char *value, int owned) {
+    if (!str_same(f->value, value))
+        f->changed = s->generation = fields_tick();
+    if (f->value_owned && f->value != value)
+        free(f->value);
+    f->value = value;
+    f->value_owned = owned;
+}
+
+/* reads the field again, a number without making its string */
+static void fields_read(rpiz_fields *s, rpiz_field *f) {
+    char *tmp;
+    double n;
+    if (f->get_num_func) {
+        n = f->get_num_func(f->data, f->index);
+        f->sampled = monotonic_seconds();
+        if (!f->num_read || n != f->num) {
+            f->num = n;
+            f->num_read = 1;
+            f->num_shown = 0;
+            f->changed = s->generation = fields_tick();
+        }
+    } else if (f->get_at_func) {
+        if (!f->value || f->live || f->expired) {
+            fields_set_value(s, f, f->get_at_func(f->data, f->index), 1);
+            f->sampled = monotonic_seconds();
+            f->expired = 0;
+        }
+    } else if (f->get_func) {
+        tmp = f->get_func(f->data);
+        f->sampled = monotonic_seconds();
+        if (f->own_value)
+            fields_set_value(s, f, tmp, 1);
+        else if (!str_same(f->value, tmp))
+            /* a copy, the getter's may not last */
+            fields_set_value(s, f, (tmp) ? strdup(tmp) : NULL, 1);
     }
-    return NULL;
 }
 
-static void fields_update(rpiz_fields *s, int live_update, int own_value, char *name, rpiz_fields_get_func get_func, void *data) {
-    if (s) {
-        if (name) {
-            free(s->name);
-            s->name = strdup(name);
+/* the value as a string, a number is only formatted here */
+static char *fields_value(rpiz_field *f) {
+    char buff[64];
+    if (f->get_num_func && f->num_read && !f->num_shown) {
+        snprintf(buff, sizeof(buff), "%.*f%s", f->decimals, f->num * f->scale, (f->unit) ? f->unit : "");
+        if (f->value_owned)
+            free(f->value);
+        f->value = strdup(buff);
+        f->value_owned = 1;
+        f->num_shown = 1;
+    }
+    return f->value;
+}
+
+void fields_detach(rpiz_fields *s) {
+    rpiz_field *f;
+    char *value;
+    int i;
+    if (!s || s->parts) return;
+    if (s->refs == 1) return; /* only the owner has it */
+    for (i = 0; i < s->tags->count; i++) {
+        f = &s->items[i];
+        if (!f->value && !f->num_read)
+            fields_read(s, f);
+        value = fields_value(f);
+        if (value && !f->value_owned) {
+            f->value = strdup(value);
+            f->value_owned = 1;
         }
-        s->live = live_update;
-        s->own_value = own_value;
-        s->get_func = get_func;
-        s->data = data;
-        if (s->get_func != NULL)
-            fields_get(s, NULL, NULL, NULL);
-        else
-            s->value = (char*)data;
+        f->live = 0;
+        f->get_func = NULL;
+        f->get_at_func = NULL;
+        f->get_num_func = NULL;
+        f->data = NULL;
+    }
+}
+
+static void fields_update(rpiz_fields *s, int i, int live_update, int own_value, char *name, rpiz_fields_get_func get_func, void *data) {
+    rpiz_field *f = &s->items[i];
+    if (name) {
+        free(f->name);
+        f->name = strdup(name);
     }
+    f->live = live_update;
+    if (f->live && !f->period_ms)
+        f->period_ms = FIELDS_DEFAULT_PERIOD_MS;
+    f->own_value = own_value;
+    f->get_func = get_func;
+    f->get_at_func = NULL;
+    f->get_num_func = NULL;
+    f->data = data;
+    if (f->get_func != NULL)
+        fields_get_at(s, i, NULL, NULL, NULL);
+    else
+        fields_set_value(s, f, (char*)data, 0);
 }
 
+/* the field with tag, added at the end if new, -1 if out of memory */
+static int fields_place(rpiz_fields *s, char *tag) {
+    int i;
+    if (s->parts) return -1; /* views can't be added to */
+    i = strlist_pos(s->tags, tag);
+    if (i < 0 && fields_append(s, tag))
+        i = s->tags->count - 1;
+    return i;
+}
 
-/* returns NULL or new item */
+/* returns NULL or the new list if s was NULL */
 rpiz_fields *fields_update_bytag(rpiz_fields *s, char *tag, int live_update, int own_value, char *name, rpiz_fields_get_func get_func, void *data) {
-    int m = 0;
     rpiz_fields *nf = NULL;
+    int i;
     if (tag == NULL) return NULL;
-    if (s) {
-        if (tag && s->tag)
-            m = !!(strcmp(tag, s->tag) == 0);
-        if (m) {
-            /* update existing */
-            fields_update(s, live_update, own_value, name, get_func, data);
-            return NULL;
-        } else {
-            nf = fields_update_bytag(s->next, tag, live_update, own_value, name, get_func, data);
-            if (nf) s->next = nf;
-            else return NULL;
-        }
-    } else {
-        /* new */
-        s = fields_new();
-        if (s) {
-            s->tag = strdup(tag);
-            fields_update(s, live_update, own_value, name, get_func, data);
-            return s;
-        }
+    if (!s)
+        s = nf = fields_new();
+    if (!s) return NULL;
+    i = fields_place(s, tag);
+    if (i >= 0)
+        fields_update(s, i, live_update, own_value, name, get_func, data);
+    return nf;
+}
+
+rpiz_fields *fields_update_bytag_at(rpiz_fields *s, char *tag, int live_update, char *name, rpiz_fields_get_at_func get_at_func, void *data, int index) {
+    rpiz_fields *nf = NULL;
+    rpiz_field *f;
+    int i;
+    if (tag == NULL || get_at_func == NULL) return NULL;
+    if (!s)
+        s = nf = fields_new();
+    if (!s) return NULL;
+    i = fields_place(s, tag);
+    if (i >= 0) {
+        /* owned, made by get_at_func when first read */
+        fields_update(s, i, live_update, 1, name, NULL, NULL);
+        f = &s->items[i];
+        f->get_at_func = get_at_func;
+        f->data = data;
+        f->index = index;
+    }
+    return nf;
+}
+
+rpiz_fields *fields_update_bytag_num(rpiz_fields *s, char *tag, int live_update, char *name, rpiz_fields_get_num_func get_num_func, void *data, int index, double scale, int decimals, const char *unit) {
+    rpiz_fields *nf = NULL;
+    rpiz_field *f;
+    int i;
+    if (tag == NULL || get_num_func == NULL) return NULL;
+    if (!s)
+        s = nf = fields_new();
+    if (!s) return NULL;
+    i = fields_place(s, tag);
+    if (i >= 0) {
+        /* the string is made when first asked for */
+        fields_update(s, i, live_update, 1, name, NULL, NULL);
+        f = &s->items[i];
+        f->get_num_func = get_num_func;
+        f->data = data;
+        f->index = index;
+        f->scale = scale;
+        f->decimals = decimals;
+        f->unit = unit;
+        f->num_read = 0;
+        f->num_shown = 0;
+        fields_read(s, f);
     }
-    return NULL;
+    return nf;
+}
+
+/* returns NULL or the new list if s was NULL */
+rpiz_fields *fields_add_table_at(rpiz_fields *s, const char *prefix, int i, int id, const rpiz_field_def *table, int n, rpiz_fields_get_at_func get_at_func, rpiz_fields_get_num_func get_num_func, void *data) {
+    char bn[256] = "", bt[256] = "";
+    rpiz_fields *nf = NULL, *made;
+    int f;
+    for (f = 0; f < n; f++) {
+        snprintf(bt, sizeof(bt), "%s[%d].%s", prefix, i, table[f].tag);
+        snprintf(bn, sizeof(bn), "[%d] %s", id, table[f].name);
+        if (table[f].unit)
+            made = fields_update_bytag_num(s, bt, !!table[f].period_ms, bn, get_num_func, data, i * n + f, 1, 0, table[f].unit);
+        else
+            made = fields_update_bytag_at(s, bt, !!table[f].period_ms, bn, get_at_func, data, i * n + f);
+        if (!s) s = nf = made;
+        fields_set_period(s, bt, table[f].period_ms);
+    }
+    return nf;
 }
 
 int fields_islive(rpiz_fields *s, char *tag) {
-    int m = 0;
-    if (s) {
-        if (tag && s->tag)
-            m = !!(strcmp(tag, s->tag) == 0);
-        if (m)
-            return s->live;
-        if (s->next)
-            return fields_islive(s->next, tag);
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f)
+        return f->live;
+    return 0;
+}
+
+int fields_get_at(rpiz_fields *s, int i, char **tag, char **name, char **value) {
+    rpiz_field *f = fields_at(&s, &i);
+    if (f) {
+        if (tag) *tag = s->tags->strs[i].str;
+        if (name) *name = f->name;
+        fields_read(s, f);
+        if (value) *value = fields_value(f);
+        return 1;
     }
     return 0;
 }
 
-int fields_get(rpiz_fields *s, char **tag, char **name, char **value) {
-    char *tmp;
-    if (s) {
-        if (tag) *tag = s->tag;
-        if (name) *name = s->name;
-        if (s->get_func) {
-            tmp = s->get_func(s->data);
-            if (s->value && s->own_value)
-                free(s->value);
-            if (tmp) {
-                if (s->own_value)
-                    s->value = tmp;
-                else {
-                    s->value = strdup(tmp);
-                }
-            } else
-                s->value = NULL;
-        }
-        if (value) *value = s->value;
+int fields_get_num_at(rpiz_fields *s, int i, double *num) {
+    rpiz_field *f = fields_at(&s, &i);
+    if (f && (f->get_num_func || f->num_read)) {
+        fields_read(s, f);
+        if (num) *num = f->num * f->scale;
+        return 1;
+    }
+    return 0;
+}
+
+int fields_peek_num_bytag(rpiz_fields *s, char *tag, double *num) {
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f && (f->get_num_func || f->num_read)) {
+        if (num) *num = f->num * f->scale;
         return 1;
     }
     return 0;
 }
 
 int fields_get_bytag(rpiz_fields *s, char *tag, char **name, char **value) {
-    int m = 0;
-    if (s) {
-        if (tag && s->tag)
-            m = !!(strcmp(tag, s->tag) == 0);
-        if (m)
-            return fields_get(s, NULL, name, value);
-        if (s->next)
-            return fields_get_bytag(s->next, tag, name, value);
+    return fields_get_at(s, fields_find(s, tag), NULL, name, value);
+}
+
+int fields_generation(rpiz_fields *s) {
+    int p, g, gen = 0;
+    if (!s) return 0;
+    if (!s->parts)
+        return s->generation;
+    for (p = 0; p < s->part_count; p++) {
+        g = fields_generation(s->parts[p]);
+        if (g > gen) gen = g;
+    }
+    return gen;
+}
+
+int fields_changed_at(rpiz_fields *s, int i) {
+    rpiz_field *f = fields_at(&s, &i);
+    if (f)
+        return f->changed;
+    return 0;
+}
+
+int fields_next_changed(rpiz_fields *s, int from, int since) {
+    int i, p, n, off = 0;
+    if (!s) return -1;
+    if (from < 0) from = 0;
+    if (s->parts) {
+        for (p = 0; p < s->part_count; p++) {
+            n = fields_count(s->parts[p]);
+            if (from < off + n) {
+                i = fields_next_changed(s->parts[p], from - off, since);
+                if (i >= 0)
+                    return off + i;
+            }
+            off += n;
+        }
+        return -1;
+    }
+    if (since >= s->generation) return -1;
+    for (i = from; i < s->tags->count; i++)
+        if (s->items[i].changed > since)
+            return i;
+    return -1;
+}
+
+int fields_peek_bytag(rpiz_fields *s, char *tag, char **value) {
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f) {
+        if (value) *value = fields_value(f);
+        return 1;
     }
     return 0;
 }
 
+void fields_set_period(rpiz_fields *s, char *tag, int period_ms) {
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f && period_ms > 0)
+        f->period_ms = period_ms;
+}
+
+void fields_expire_bytag(rpiz_fields *s, char *tag) {
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f)
+        f->expired = 1;
+}
+
+double fields_sampled(rpiz_fields *s, char *tag) {
+    int i = fields_find(s, tag);
+    rpiz_field *f = fields_at(&s, &i);
+    if (f)
+        return f->sampled;
+    return 0;
+}
+
+/* a min-heap of the live fields, by when each is next due */
+typedef struct {
+    double due;
+    rpiz_fields *list; /* the part of a view that holds it */
+    int i;
+} sched_entry;
+
+struct fields_sched {
+    rpiz_fields *fields;
+    sched_entry *heap;
+    int count;
+};
+
+static void sched_sift_down(fields_sched *s, int k) {
+    sched_entry e = s->heap[k];
+    int c;
+    while ((c = 2 * k + 1) < s->count) {
+        if (c + 1 < s->count && s->heap[c + 1].due < s->heap[c].due)
+            c++;
+        if (s->heap[c].due >= e.due)
+            break;
+        s->heap[k] = s->heap[c];
+        k = c;
+    }
+    s->heap[k] = e;
+}
+
+fields_sched *fields_sched_new(rpiz_fields *fields) {
+    fields_sched *s;
+    rpiz_fields *l;
+    rpiz_field *f;
+    int i, j, n;
+    s = calloc(1, sizeof(fields_sched));
+    if (!s) return NULL;
+    n = fields_count(fields);
+    s->heap = malloc(sizeof(sched_entry) * (n + 1));
+    if (!s->heap) {
+        free(s);
+        return NULL;
+    }
+    s->fields = fields_ref(fields);
+    for (i = 0; i < n; i++) {
+        l = fields;
+        j = i;
+        f = fields_at(&l, &j);
+        if (!f || !f->live) continue;
+        s->heap[s->count].list = l;
+        s->heap[s->count].i = j;
+        s->heap[s->count].due = f->sampled + f->period_ms / 1000.0;
+        s->count++;
+    }
+    for (i = s->count / 2 - 1; i >= 0; i--)
+        sched_sift_down(s, i);
+    return s;
+}
+
+void fields_sched_free(fields_sched *s) {
+    if (s) {
+        fields_free(s->fields);
+        free(s->heap);
+        free(s);
+    }
+}
+
+/* due within a millisecond is due now, to not wake again for it */
+#define SCHED_SLACK 0.001
+
+int fields_sched_poll(fields_sched *s, fields_sched_func func, void *data) {
+    rpiz_fields *l;
+    rpiz_field *f;
+    double now;
+    int n = 0, gen;
+    if (!s) return 0;
+    now = monotonic_seconds();
+    while (s->count && s->heap[0].due <= now + SCHED_SLACK) {
+        l = s->heap[0].list;
+        f = &l->items[s->heap[0].i];
+        gen = l->generation;
+        fields_read(l, f);
+        if (l->generation != gen) {
+            if (func) {
+                /* only now is a number made a string */
+                func(data, l->tags->strs[s->heap[0].i].str, f->name, fields_value(f));
+            }
+            n++;
+        }
+        /* from now, a late poll doesn't bunch up the next ones */
+        s->heap[0].due = now + f->period_ms / 1000.0;
+        sched_sift_down(s, 0);
+    }
+    return n;
+}
+
+int fields_sched_next_ms(fields_sched *s) {
+    double ms;
+    if (!s || !s->count) return -1;
+    ms = (s->heap[0].due - monotonic_seconds()) * 1000.0;
+    if (ms <= 0) return 0;
+    return (int)ms + 1;
+}
+
 void fields_dump(rpiz_fields *s) {
     char *t, *n, *v;
-    rpiz_fields *f = s;
-    while (f) {
-        fields_get(f, &t, &n, &v);
+    int i;
+    for (i = 0; i < fields_count(s); i++) {
+        fields_get_at(s, i, &t, &n, &v);
         printf("[%s] %s = %s\n", t, n, v);
-        f = fields_next(f);
     }
 }
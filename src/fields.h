@@ -24,19 +24,84 @@
 typedef struct rpiz_fields rpiz_fields;
 
 typedef char* (*rpiz_fields_get_func)(void *data);
+/* for one of many similar fields, returns a new string */
+typedef char* (*rpiz_fields_get_at_func)(void *data, int index);
+/* a number, read without making a string */
+typedef double (*rpiz_fields_get_num_func)(void *data, int index);
 
+/* fields are kept in insert order, 0 to fields_count() - 1,
+ * and found by tag through a hash */
 rpiz_fields *fields_new(void);
 rpiz_fields *fields_copy(rpiz_fields *src, rpiz_fields *append_src);
-rpiz_fields *fields_next(rpiz_fields *);
+/* the fields of each of parts in turn, shared not copied, so a
+ * value read through the view is read in the part. Each part is
+ * referenced until the view is freed. Views can't be added to */
+rpiz_fields *fields_view_new(rpiz_fields **parts, int count);
+/* one more fields_free() is needed to free it */
+rpiz_fields *fields_ref(rpiz_fields *);
+/* for the owner of the getters' data, before it is freed: a view
+ * may still hold the list, so each value is kept as last read, or
+ * read now, and no getter is called again */
+void fields_detach(rpiz_fields *);
+int fields_count(rpiz_fields *);
+int fields_find(rpiz_fields *, const char *tag); /* -1 if not found */
 
-int fields_tag_has_prefix(rpiz_fields *, const char *prefix);
-rpiz_fields *fields_next_with_tag_prefix(rpiz_fields *, const char *prefix);
+/* the first at or after from with a tag that starts with prefix, or -1 */
+int fields_next_with_tag_prefix(rpiz_fields *, int from, const char *prefix);
 
+/* these return the new list if given NULL, else NULL */
 rpiz_fields *fields_update_bytag(rpiz_fields *, char *tag, int live_update, int own_value, char *name, rpiz_fields_get_func get_func, void *data);
+/* the value is only made by get_at_func(data, index) when first read */
+rpiz_fields *fields_update_bytag_at(rpiz_fields *, char *tag, int live_update, char *name, rpiz_fields_get_at_func get_at_func, void *data, int index);
+/* the number from get_num_func(data, index) is only made a string,
+ * num * scale with decimals places then unit, when one is asked for */
+rpiz_fields *fields_update_bytag_num(rpiz_fields *, char *tag, int live_update, char *name, rpiz_fields_get_num_func get_num_func, void *data, int index, double scale, int decimals, const char *unit);
+/* one of a table of fields added alike for each of many things */
+typedef struct {
+    const char *tag, *name;
+    int period_ms; /* 0 for not live */
+    const char *unit; /* a number field, shown whole, if not NULL */
+} rpiz_field_def;
+/* adds "prefix[i].tag" named "[id] name" for each of the n in table,
+ * made by get_at_func(data, i * n + f), or get_num_func for a number */
+rpiz_fields *fields_add_table_at(rpiz_fields *, const char *prefix, int i, int id, const rpiz_field_def *table, int n, rpiz_fields_get_at_func get_at_func, rpiz_fields_get_num_func get_num_func, void *data);
 int fields_islive(rpiz_fields *, char *tag);
-int fields_get(rpiz_fields *, char **tag, char **name, char **value);
+int fields_get_at(rpiz_fields *, int i, char **tag, char **name, char **value);
 int fields_get_bytag(rpiz_fields *, char *tag, char **name, char **value);
 void fields_free(rpiz_fields *);
+/* for number fields only, num * scale. 0 if not a number field.
+ * A detached one keeps the last number read */
+int fields_get_num_at(rpiz_fields *, int i, double *num);
+int fields_peek_num_bytag(rpiz_fields *, char *tag, double *num);
+
+/* each value that differs from the last one read bumps the list's
+ * generation, and the field remembers the generation it changed in */
+int fields_generation(rpiz_fields *);
+int fields_changed_at(rpiz_fields *, int i);
+/* the first at or after from that changed after generation since, or -1 */
+int fields_next_changed(rpiz_fields *, int from, int since);
+
+/* live fields are read again every period_ms by a fields_sched */
+#define FIELDS_DEFAULT_PERIOD_MS 500
+void fields_set_period(rpiz_fields *, char *tag, int period_ms);
+/* a value made only when first read is made again at the next read */
+void fields_expire_bytag(rpiz_fields *, char *tag);
+/* the value from the last read, without reading it again */
+int fields_peek_bytag(rpiz_fields *, char *tag, char **value);
+double fields_sampled(rpiz_fields *, char *tag); /* monotonic_seconds() */
+
+/* reads only the live fields that are due, soonest first. For a list
+ * that won't have fields added or removed while the scheduler is used */
+typedef struct fields_sched fields_sched;
+typedef void (*fields_sched_func)(void *data, const char *tag, const char *name, const char *value);
+
+fields_sched *fields_sched_new(rpiz_fields *);
+void fields_sched_free(fields_sched *);
+/* reads each due field, calling func after each that changed if
+ * given. returns how many changed */
+int fields_sched_poll(fields_sched *, fields_sched_func func, void *data);
+/* ms until the next is due, -1 if there are no live fields */
+int fields_sched_next_ms(fields_sched *);
 
 void fields_dump(rpiz_fields *);
 
@@ -0,0 +1,279 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include "util.h"
+#include "numa.h"
+
+#define NODE_DIR "/sys/devices/system/node"
+
+typedef struct {
+    int id;
+    char *cpus;
+    long mem_total_kb;
+    int *distance; /* to each node, in nodes[] order */
+    char hugepages[256];
+    char meminfo[128]; /* path, read live for MemFree */
+} numa_node;
+
+struct numa_nodes {
+    numa_node *nodes;
+    int count;
+    rpiz_fields *fields;
+};
+
+/* "Node 0 MemFree:         3305104 kB" */
+static long meminfo_kb(const char *meminfo, const char *key) {
+    const char *p = meminfo ? strstr(meminfo, key) : NULL;
+    if (p)
+        return atol(p + strlen(key));
+    return 0;
+}
+
+/* sizes with any pages reserved, "2048 kB: 512 (500 free)" */
+static void read_hugepages(numa_node *n) {
+    char path[512], buff[32];
+    struct dirent *de;
+    DIR *dir;
+    long size, nr, nfree;
+    int l = 0;
+
+    n->hugepages[0] = 0;
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/hugepages", n->id);
+    dir = opendir(path);
+    if (!dir) return;
+    while ((de = readdir(dir))) {
+        if (sscanf(de->d_name, "hugepages-%ldkB", &size) != 1)
+            continue;
+        snprintf(path, sizeof(path), NODE_DIR "/node%d/hugepages/%s/nr_hugepages", n->id, de->d_name);
+        nr = (get_file_contents_buf(path, buff, sizeof(buff)) > 0) ? atol(buff) : 0;
+        if (nr <= 0) continue;
+        snprintf(path, sizeof(path), NODE_DIR "/node%d/hugepages/%s/free_hugepages", n->id, de->d_name);
+        nfree = (get_file_contents_buf(path, buff, sizeof(buff)) > 0) ? atol(buff) : 0;
+        if (l < (int)sizeof(n->hugepages))
+            l += snprintf(n->hugepages + l, sizeof(n->hugepages) - l, "%s%ld kB: %ld (%ld free)",
+                (l > 0) ? ", " : "", size, nr, nfree);
+    }
+    closedir(dir);
+}
+
+static void read_node(numa_nodes *s, numa_node *n) {
+    char path[256], *str, *p, *nl;
+    int i;
+
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/cpulist", n->id);
+    n->cpus = get_file_contents(path);
+    if (n->cpus)
+        if ((nl = strchr(n->cpus, '\n')))
+            *nl = 0;
+
+    snprintf(n->meminfo, sizeof(n->meminfo), NODE_DIR "/node%d/meminfo", n->id);
+    str = get_file_contents(n->meminfo);
+    n->mem_total_kb = meminfo_kb(str, "MemTotal:");
+    free(str);
+
+    /* one column for each node, in node id order */
+    n->distance = calloc(s->count, sizeof(int));
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/distance", n->id);
+    str = get_file_contents(path);
+    if (str && n->distance)
+        for (i = 0, p = str; i < s->count; i++)
+            n->distance[i] = strtol(p, &p, 10);
+    free(str);
+
+    read_hugepages(n);
+}
+
+numa_nodes *numa_nodes_new(void) {
+    numa_nodes *s;
+    char *online;
+    int *ids, i;
+
+    s = calloc(1, sizeof(numa_nodes));
+    if (!s) return NULL;
+    online = get_file_contents(NODE_DIR "/online");
+    if (!online) return s;
+    s->count = cpulist_count(online);
+    ids = malloc(sizeof(int) * (s->count + 1));
+    s->nodes = calloc(s->count + 1, sizeof(numa_node));
+    if (!ids || !s->nodes) {
+        free(ids);
+        free(online);
+        s->count = 0;
+        return s;
+    }
+    cpulist_ids(online, ids, s->count);
+    for (i = 0; i < s->count; i++) {
+        s->nodes[i].id = ids[i];
+        read_node(s, &s->nodes[i]);
+    }
+    free(ids);
+    free(online);
+    return s;
+}
+
+void numa_nodes_free(numa_nodes *s) {
+    int i;
+    if (s) {
+        fields_detach(s->fields);
+        for (i = 0; i < s->count; i++) {
+            free(s->nodes[i].cpus);
+            free(s->nodes[i].distance);
+        }
+        free(s->nodes);
+        fields_free(s->fields);
+        free(s);
+    }
+}
+
+static numa_node *get_node(numa_nodes *s, int node) {
+    if (s && node >= 0 && node < s->count)
+        return &s->nodes[node];
+    return NULL;
+}
+
+int numa_node_count(numa_nodes *s) {
+    return (s) ? s->count : 0;
+}
+
+int numa_node_id(numa_nodes *s, int node) {
+    numa_node *n = get_node(s, node);
+    return (n) ? n->id : -1;
+}
+
+int numa_node_of_cpu(numa_nodes *s, int cpu) {
+    int i;
+    if (s)
+        for (i = 0; i < s->count; i++)
+            if (cpulist_has(s->nodes[i].cpus, cpu))
+                return i;
+    return -1;
+}
+
+const char *numa_node_cpus(numa_nodes *s, int node) {
+    numa_node *n = get_node(s, node);
+    return (n) ? n->cpus : NULL;
+}
+
+long numa_node_mem_total_kb(numa_nodes *s, int node) {
+    numa_node *n = get_node(s, node);
+    return (n) ? n->mem_total_kb : 0;
+}
+
+/* meminfo stays open, see get_file_contents_live() */
+long numa_node_mem_free_kb(numa_nodes *s, int node) {
+    numa_node *n = get_node(s, node);
+    char buff[4096];
+    if (n && get_file_contents_live(n->meminfo, buff, sizeof(buff)) > 0)
+        return meminfo_kb(buff, "MemFree:");
+    return 0;
+}
+
+int numa_node_distance(numa_nodes *s, int node, int to_node) {
+    numa_node *n = get_node(s, node);
+    if (n && n->distance && to_node >= 0 && to_node < s->count)
+        return n->distance[to_node];
+    return 0;
+}
+
+const char *numa_node_hugepages(numa_nodes *s, int node) {
+    numa_node *n = get_node(s, node);
+    return (n) ? n->hugepages : NULL;
+}
+
+static double numa_nodes_count_num(numa_nodes *s, int i) {
+    i = i; /* avoid a warning */
+    return numa_node_count(s);
+}
+
+#define ADDFIELDNUM(t, l, n, f, sc, d, u) fields_update_bytag_num(s->fields, t, l, n, (rpiz_fields_get_num_func)f, (void*)s, 0, sc, d, u)
+/* per-node fields, made only when read */
+enum {
+    NF_CPUS, NF_MEM_TOTAL, NF_MEM_FREE, NF_DISTANCE, NF_HUGEPAGES,
+    NF_N
+};
+
+static const rpiz_field_def node_fields[NF_N] = {
+    { "cpus",      "cpus",          0,    NULL },
+    { "mem_total", "memory",        0,    " MB" },
+    { "mem_free",  "free memory",   1000, " MB" },
+    { "distance",  "distance",      0,    NULL },
+    { "hugepages", "huge pages",    0,    NULL },
+};
+
+/* index is node * NF_N + field, memory in MB */
+static double node_field_num(numa_nodes *s, int index) {
+    if (index % NF_N == NF_MEM_TOTAL)
+        return numa_node_mem_total_kb(s, index / NF_N) / 1024.0;
+    return numa_node_mem_free_kb(s, index / NF_N) / 1024.0;
+}
+
+/* index is node * NF_N + field */
+static char *node_field(numa_nodes *s, int index) {
+    numa_node *n = &s->nodes[index / NF_N];
+    char buff[256] = "";
+    int i, l = 0;
+    switch (index % NF_N) {
+        case NF_CPUS:
+            snprintf(buff, 256, "%s", n->cpus ? n->cpus : ""); break;
+        case NF_DISTANCE:
+            for (i = 0; i < s->count && l < 256 && n->distance; i++)
+                l += snprintf(buff + l, 256 - l, "%s%d", (i > 0) ? " " : "", n->distance[i]);
+            break;
+        case NF_HUGEPAGES:
+            snprintf(buff, 256, "%s", n->hugepages[0] ? n->hugepages : "none"); break;
+    }
+    return strdup(buff);
+}
+
+rpiz_fields *numa_nodes_fields(numa_nodes *s) {
+    int i;
+    if (s) {
+        if (!s->fields) {
+            /* first insert creates */
+            s->fields =
+            ADDFIELDNUM("numa.node_count", 0, "NUMA Nodes", numa_nodes_count_num, 1, 0, NULL );
+
+            for (i = 0; i < s->count; i++)
+                fields_add_table_at(s->fields, "numa.node", i, s->nodes[i].id, node_fields, NF_N,
+                    (rpiz_fields_get_at_func)node_field, (rpiz_fields_get_num_func)node_field_num, (void*)s);
+        }
+        return s->fields;
+    }
+    return NULL;
+}
+
+static numa_nodes *numa;
+
+int numa_init(void) {
+    numa = numa_nodes_new();
+    return (numa != NULL);
+}
+
+void numa_cleanup(void) {
+    numa_nodes_free(numa);
+    numa = NULL;
+}
+
+rpiz_fields *numa_fields(void) {
+    return numa_nodes_fields(numa);
+}
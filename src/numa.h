@@ -0,0 +1,48 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+#include "fields.h"
+
+/* this machine's nodes */
+int numa_init(void);
+void numa_cleanup(void);
+
+rpiz_fields *numa_fields(void);
+
+/* /sys/devices/system/node/node*, none on a kernel without NUMA */
+typedef struct numa_nodes numa_nodes;
+
+numa_nodes *numa_nodes_new(void);
+void numa_nodes_free(numa_nodes *);
+
+int numa_node_count(numa_nodes *);
+int numa_node_id(numa_nodes *, int node);
+int numa_node_of_cpu(numa_nodes *, int cpu); /* -1 if not found */
+const char *numa_node_cpus(numa_nodes *, int node); /* cpu list */
+long numa_node_mem_total_kb(numa_nodes *, int node);
+long numa_node_mem_free_kb(numa_nodes *, int node); /* read again each call */
+int numa_node_distance(numa_nodes *, int node, int to_node);
+const char *numa_node_hugepages(numa_nodes *, int node);
+
+rpiz_fields *numa_nodes_fields(numa_nodes *);
+
+#endif
@@ -21,8 +21,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include <ctype.h>
 #include "riscv_data.h"
+#include "util.h"
 
 #ifndef _
 #define _(String) String
@@ -70,6 +72,22 @@ const char *riscv_ext_list() {
     return all_extensions;
 }
 
+/* table order, NULL past the end */
+const char *riscv_ext_name(int index) {
+    /* less the NULL row */
+    const int count = sizeof(tab_ext_meaning) / sizeof(tab_ext_meaning[0]) - 1;
+    if (index < 0 || index >= count)
+        return NULL;
+    return tab_ext_meaning[index].name;
+}
+
+static name_index ext_index = NAME_INDEX(tab_ext_meaning, 1);
+static pthread_once_t ext_index_once = PTHREAD_ONCE_INIT;
+
+static void ext_index_make(void) {
+    name_index_make(&ext_index);
+}
+
 const char *riscv_ext_meaning(const char *ext) {
     int i = 0, l = 0;
     char *c = NULL;
@@ -79,14 +97,10 @@ const char *riscv_ext_meaning(const char *ext) {
             l = c - ext;
         else
             l = strlen(ext);
-        while(tab_ext_meaning[i].name != NULL) {
-            if (strncasecmp(tab_ext_meaning[i].name, ext, l) == 0) {
-                if (tab_ext_meaning[i].meaning != NULL)
-                    return _(tab_ext_meaning[i].meaning);
-                else return NULL;
-            }
-            i++;
-        }
+        pthread_once(&ext_index_once, ext_index_make);
+        i = name_index_find(&ext_index, ext, l);
+        if (i >= 0 && tab_ext_meaning[i].meaning != NULL)
+            return _(tab_ext_meaning[i].meaning);
     }
     return NULL;
 }
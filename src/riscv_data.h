@@ -26,6 +26,8 @@ char *riscv_isa_to_flags(const char *isa);
 
 /* all known extensions as flags list */
 const char *riscv_ext_list(void);
+/* known extensions, in order */
+const char *riscv_ext_name(int index);
 
 /* get meaning of flag */
 const char *riscv_ext_meaning(const char *ext);
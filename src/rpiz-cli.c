@@ -21,20 +21,110 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include "util.h"
 #include "board.h"
 #include "cpu.h"
+#include "cache.h"
+#include "numa.h"
 
-int main(void) {
-    rpiz_fields *bf, *pf;
+/* board, cpu, cache and numa fields as one list, not copied */
+static rpiz_fields *view_all_fields(void) {
+    rpiz_fields *parts[] = { board_fields(), cpu_fields(), cache_fields(), numa_fields() };
+    return fields_view_new(parts, sizeof(parts) / sizeof(parts[0]));
+}
+
+static void watch_print(void *data, const char *tag, const char *name, const char *value) {
+    printf("%.3f [%s] %s = %s\n", monotonic_seconds() - *(double*)data, tag, name, value);
+}
+
+/* everything once, then each live field again as it comes due but
+ * printed only if it changed, for seconds or until interrupted if 0.
+ * A hotplug dumps it all again. */
+static void watch(double seconds) {
+    rpiz_fields *all;
+    fields_sched *sched;
+    struct timespec ts;
+    double start = monotonic_seconds(), left;
+    int ms;
+
+    all = view_all_fields();
+    fields_dump(all);
+    /* after the dump, so what it read isn't due again at once */
+    sched = fields_sched_new(all);
+    while (seconds <= 0 || (left = seconds - (monotonic_seconds() - start)) > 0) {
+        /* with nothing live, still look for hotplug now and then */
+        ms = fields_sched_next_ms(sched);
+        if (ms < 0 || ms > 1000) ms = 1000;
+        if (seconds > 0 && ms > left * 1000) ms = left * 1000;
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000000L;
+        nanosleep(&ts, NULL);
+        if (cpu_update()) {
+            fields_sched_free(sched);
+            fields_free(all);
+            all = view_all_fields();
+            printf("# cpus changed\n");
+            fields_dump(all);
+            sched = fields_sched_new(all);
+        }
+        fields_sched_poll(sched, watch_print, &start);
+        fflush(stdout);
+    }
+    fields_sched_free(sched);
+    fields_free(all);
+}
+
+int main(int argc, char *argv[]) {
+    rpiz_fields *bf, *pf, *cf, *nf;
+    cpu_proc *cp;
+    int i;
+
+    if (argc > 1 && strcmp(argv[1], "--watch") == 0) {
+        board_init();
+        cpu_init();
+        cache_init();
+        numa_init();
+        watch((argc > 2) ? atof(argv[2]) : 0);
+        cache_cleanup();
+        numa_cleanup();
+        board_cleanup();
+        cpu_cleanup();
+        live_cache_flush();
+        return 0;
+    }
+
+    if (argc > 1) {
+        /* cpuinfo dumps, perhaps from other machines */
+        for (i = 1; i < argc; i++) {
+            cp = cpu_proc_new_file(argv[i]);
+            if (!cp) {
+                fprintf(stderr, "%s: not a cpuinfo that can be read\n", argv[i]);
+                continue;
+            }
+            printf("# %s (%s)\n", argv[i], cpu_proc_arch(cp));
+            fields_dump(cpu_proc_fields(cp));
+            cpu_proc_free(cp);
+        }
+        return 0;
+    }
 
     board_init();
     cpu_init();
+    cache_init();
+    numa_init();
 
     bf = board_fields();
     fields_dump(bf);
     pf = cpu_fields();
     fields_dump(pf);
+    cf = cache_fields();
+    fields_dump(cf);
+    nf = numa_fields();
+    fields_dump(nf);
 
+    cache_cleanup();
+    numa_cleanup();
     board_cleanup();
     cpu_cleanup();
     return 0;
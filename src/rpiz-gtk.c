@@ -18,10 +18,12 @@
  *
  */
 
+#include "util.h"
 #include "board.h"
 #include "cpu.h"
+#include "cache.h"
+#include "numa.h"
 #include "board_rpi.h"
-#include "cpu_arm.h"
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-prototypes"
 #include <gtk/gtk.h>
@@ -33,32 +35,47 @@ const char about_text[] =
     "https://github.com/bp0/rpiz\n"
     "\n";
 
-arm_proc *proc; // TODO
 rpiz_fields *all_fields;
+fields_sched *sched; /* live fields of all_fields */
+int shown_gen; /* generation of all_fields the stores show */
+
+/* board, cpu, cache and numa fields as one list, not copied */
+static rpiz_fields *view_all_fields(void) {
+    rpiz_fields *parts[] = { board_fields(), cpu_fields(), cache_fields(), numa_fields() };
+    return fields_view_new(parts, sizeof(parts) / sizeof(parts[0]));
+}
 
 static int rpiz_init(void) {
-    rpiz_fields *bf, *pf;
     board_init();
     cpu_init();
-    proc = arm_proc_new(); // TODO
-    bf = board_fields();
-    pf = cpu_fields();
-    all_fields = fields_copy(bf, pf);
+    cache_init();
+    numa_init();
+    all_fields = view_all_fields();
+    sched = fields_sched_new(all_fields);
     return 1;
 }
 
 static void rpiz_cleanup(void) {
-    arm_proc_free(proc); // TODO
+    fields_sched_free(sched);
     fields_free(all_fields);
+    cache_cleanup();
+    numa_cleanup();
     board_cleanup();
     cpu_cleanup();
+    live_cache_flush();
 }
 
+/* hotplug and cpufreq */
 struct {
     gint timeout_id;
     gint interval_ms;
 } refresh_timer;
 
+/* set for when the next live field is due */
+struct {
+    gint timeout_id;
+} fields_timer;
+
 enum
 {
    KV_COL_KEY,
@@ -112,6 +129,10 @@ struct {
     GtkWidget *board_view;
     GtkListStore *cpu_store;
     GtkWidget *cpu_view;
+    GtkListStore *cache_store;
+    GtkWidget *cache_view;
+    GtkListStore *numa_store;
+    GtkWidget *numa_view;
     GtkListStore *cpufreq_store;
     GtkWidget *cpufreq_view;
     GtkListStore *flags_store;
@@ -134,30 +155,23 @@ static void kv_fill_store_by_fields(GtkListStore *store, char *prefix) {
     GtkTreeIter iter;
     gtk_list_store_clear (store);
     char *tag, *name, *value;
-    int m, l;
-    rpiz_fields *f = all_fields;
-    while (f) {
-        m = 1;
-        if (prefix)
-            if (!fields_tag_has_prefix(f, prefix))
-                m = 0;
-
-        if (m)
-            if (fields_get(f, &tag, &name, &value)) {
-                l = fields_islive(f, tag);
-                KV_ADD(name, value, tag, l);
-            }
-
-        if (prefix)
-            f = fields_next_with_tag_prefix(f, prefix);
+    int i, l;
+    i = fields_next_with_tag_prefix(all_fields, 0, prefix);
+    while (i >= 0) {
+        if (fields_get_at(all_fields, i, &tag, &name, &value)) {
+            l = fields_islive(all_fields, tag);
+            KV_ADD(name, value, tag, l);
+        }
+        i = fields_next_with_tag_prefix(all_fields, i + 1, prefix);
     }
 }
 
-static void kv_view_update(GtkListStore *store) {
+/* only rows whose value changed since generation since are set */
+static void kv_view_update(GtkListStore *store, int since) {
     GtkTreeIter  iter;
     gboolean     valid;
     gchar *tag, *value;
-    int live;
+    int live, i;
 
     /* Get first row in list store */
     valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter);
@@ -167,8 +181,12 @@ static void kv_view_update(GtkListStore *store) {
         gtk_tree_model_get(GTK_TREE_MODEL(store), &iter, KV_COL_LIVE, &live, -1);
         if (live) {
             gtk_tree_model_get(GTK_TREE_MODEL(store), &iter, KV_COL_TAG, &tag, -1);
-            fields_get_bytag(all_fields, tag, NULL, &value);
-            gtk_list_store_set(store, &iter, KV_COL_VALUE, value, -1);
+            i = fields_find(all_fields, tag);
+            if (fields_changed_at(all_fields, i) > since) {
+                fields_peek_bytag(all_fields, tag, &value);
+                gtk_list_store_set(store, &iter, KV_COL_VALUE, value, -1);
+            }
+            g_free(tag);
         }
 
         /* Get next row */
@@ -190,12 +208,13 @@ static void fill_cpufreq_list(void) {
     gtk_list_store_clear (gel.cpufreq_store);
     int cores = 0, c = 0;
     char id[16] = "", cur[24] = "", min[24] = "", max[24] = "";
-    cores = arm_proc_cores(proc);
+    cpu_freq_sample();
+    cores = cpu_cores();
     for (c = 0; c < cores; c++) {
-        sprintf(id, "%d", arm_proc_core_id(proc, c));
-        sprintf(cur, "%0.2f MHz", (double)arm_proc_core_khz_cur(proc, c) / 1000);
-        sprintf(min, "%0.2f MHz", (double)arm_proc_core_khz_min(proc, c) / 1000);
-        sprintf(max, "%0.2f MHz", (double)arm_proc_core_khz_max(proc, c) / 1000);
+        sprintf(id, "%d", cpu_core_id(c));
+        sprintf(cur, "%0.2f MHz", (double)cpu_core_khz_cur(c) / 1000);
+        sprintf(min, "%0.2f MHz", (double)cpu_core_khz_min(c) / 1000);
+        sprintf(max, "%0.2f MHz", (double)cpu_core_khz_max(c) / 1000);
         CPUFREQ_ADD(id, cur, min, max);
     }
 }
@@ -203,23 +222,22 @@ static void fill_cpufreq_list(void) {
 static void update_cpufreq_list(void) {
     GtkTreeIter  iter;
     gboolean     valid;
-    gchar *core_id;
     char cur[24] = "";
-    int c;
+    int c = 0;
+
+    /* one snapshot for all rows, which were added in core order */
+    cpu_freq_sample();
 
     /* Get first row in list store */
     valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(gel.cpufreq_store), &iter);
 
     while (valid)
     {
-        gtk_tree_model_get(GTK_TREE_MODEL(gel.cpufreq_store), &iter, CPUFREQ_COL_KEY, &core_id, -1);
-        c = g_ascii_strtoll(core_id, NULL, 10);
-        c = arm_proc_core_from_id(proc, c);
-
-        sprintf(cur, "%0.2f MHz", (double)arm_proc_core_khz_cur(proc, c) / 1000);
+        sprintf(cur, "%0.2f MHz", (double)cpu_core_khz_cur(c) / 1000);
         gtk_list_store_set(gel.cpufreq_store, &iter, CPUFREQ_COL_VALUE, cur, -1);
 
         /* Get next row */
+        c++;
         valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(gel.cpufreq_store), &iter);
     }
 }
@@ -236,6 +254,7 @@ static void fill_flags_list(void) {
     GtkTreeIter iter;
     gint i = 0, core_count = 0;
     gchar **all_flags;
+    gtk_list_store_clear (gel.flags_store);
     all_flags = g_strsplit(cpu_all_flags(), " ", 0);
     while(all_flags[i] != NULL) {
         if (g_strcmp0(all_flags[i], "") != 0) {
@@ -253,6 +272,8 @@ static void init_list_stores(void) {
     gel.summary_store = kv_store_create();
     gel.board_store = kv_store_create();
     gel.cpu_store = kv_store_create();
+    gel.cache_store = kv_store_create();
+    gel.numa_store = kv_store_create();
 
     gel.cpufreq_store =
     gtk_list_store_new (CPUFREQ_N_COLUMNS,
@@ -284,6 +305,8 @@ static void destroy( GtkWidget *widget,
     widget = widget; /* to avoid a warning */
     data = data; /* to avoid a warning */
     g_source_remove(refresh_timer.timeout_id);
+    if (fields_timer.timeout_id)
+        g_source_remove(fields_timer.timeout_id);
     rpiz_cleanup();
     gtk_main_quit();
 }
@@ -339,12 +362,54 @@ static void flags_view_init(void) {
     }
 }
 
+static void fill_stores(void) {
+    kv_fill_store_by_fields(gel.summary_store, "summary.");
+    kv_fill_store_by_fields(gel.board_store, "board.");
+    kv_fill_store_by_fields(gel.cpu_store, "cpu.");
+    kv_fill_store_by_fields(gel.cache_store, "cache.");
+    kv_fill_store_by_fields(gel.numa_store, "numa.");
+    fill_cpufreq_list();
+    fill_flags_list();
+    shown_gen = fields_generation(all_fields);
+}
+
+static gboolean refresh_fields(gpointer data);
+
+static void schedule_fields(void) {
+    int ms = fields_sched_next_ms(sched);
+    fields_timer.timeout_id = (ms >= 0) ? g_timeout_add(ms, refresh_fields, NULL) : 0;
+}
+
+/* only the live fields that are due are read, and
+ * only those that changed are shown again */
+static gboolean refresh_fields(gpointer data) {
+    data = data; /* to avoid a warning */
+    if (fields_sched_poll(sched, NULL, NULL)) {
+        kv_view_update(gel.summary_store, shown_gen);
+        kv_view_update(gel.board_store, shown_gen);
+        kv_view_update(gel.cpu_store, shown_gen);
+        kv_view_update(gel.numa_store, shown_gen);
+        shown_gen = fields_generation(all_fields);
+    }
+    schedule_fields();
+    return G_SOURCE_REMOVE;
+}
+
 static gboolean refresh_data(gpointer data) {
     data = data; /* to avoid a warning */
+    if (cpu_update()) {
+        /* cores came or went, rows may have too */
+        if (fields_timer.timeout_id)
+            g_source_remove(fields_timer.timeout_id);
+        fields_sched_free(sched);
+        fields_free(all_fields);
+        all_fields = view_all_fields();
+        sched = fields_sched_new(all_fields);
+        fill_stores();
+        schedule_fields();
+        return G_SOURCE_CONTINUE;
+    }
     update_cpufreq_list();
-    kv_view_update(gel.summary_store);
-    kv_view_update(gel.board_store);
-    kv_view_update(gel.cpu_store);
     return G_SOURCE_CONTINUE;
 }
 
@@ -353,11 +418,7 @@ int main( int   argc,
 {
     rpiz_init();
     init_list_stores();
-    kv_fill_store_by_fields(gel.summary_store, "summary.");
-    kv_fill_store_by_fields(gel.board_store, "board.");
-    kv_fill_store_by_fields(gel.cpu_store, "cpu.");
-    fill_cpufreq_list();
-    fill_flags_list();
+    fill_stores();
 
     /* dump data to console */
     fields_dump(all_fields);
@@ -367,6 +428,7 @@ int main( int   argc,
 
     refresh_timer.interval_ms = 500;
     refresh_timer.timeout_id = g_timeout_add(refresh_timer.interval_ms, refresh_data, NULL);
+    schedule_fields();
 
     /* GUI */
     GtkWidget *window;
@@ -391,11 +453,15 @@ int main( int   argc,
     V(gel.summary_view, gel.summary_store);
     V(gel.board_view, gel.board_store);
     V(gel.cpu_view, gel.cpu_store);
+    V(gel.cache_view, gel.cache_store);
+    V(gel.numa_view, gel.numa_store);
     V(gel.cpufreq_view, gel.cpufreq_store);
     V(gel.flags_view, gel.flags_store);
     kv_view_init(gel.summary_view);
     kv_view_init(gel.board_view);
     kv_view_init(gel.cpu_view);
+    kv_view_init(gel.cache_view);
+    kv_view_init(gel.numa_view);
     cpufreq_view_init();
     flags_view_init();
 
@@ -409,6 +475,8 @@ int main( int   argc,
     add_notebook_page("Summary", notebook, mbox, 0);
     add_notebook_page("Board", notebook, gel.board_view, 10);
     add_notebook_page("CPU", notebook, gel.cpu_view, 10);
+    add_notebook_page("Cache", notebook, gel.cache_view, 10);
+    add_notebook_page("NUMA", notebook, gel.numa_view, 10);
     add_notebook_page("CPU Flags", notebook, gel.flags_view, 10);
     add_notebook_page("About", notebook, about_page, 0);
 
@@ -0,0 +1,262 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "util.h"
+#include "topology.h"
+
+typedef struct {
+    int cpu;
+    int id[TOPO_N_LEVELS];   /* as given, -1 unknown */
+    int key[TOPO_N_LEVELS];  /* id with the unknowns filled in */
+    int node[TOPO_N_LEVELS];
+    char *siblings;
+} topo_cpu;
+
+struct cpu_topology {
+    topo_cpu *cpus;
+    int count;
+    int alloc;
+
+    int *index;     /* logical cpu id -> cpus[] */
+    int index_size;
+
+    int nodes[TOPO_N_LEVELS];
+    char summary[128];
+    int generation;
+    int from_sysfs;
+};
+
+cpu_topology *topology_new(void) {
+    return calloc(1, sizeof(cpu_topology));
+}
+
+void topology_clear(cpu_topology *t) {
+    int i;
+    if (t) {
+        for (i = 0; i < t->count; i++)
+            free(t->cpus[i].siblings);
+        t->count = 0;
+        free(t->index);
+        t->index = NULL;
+        t->index_size = 0;
+        memset(t->nodes, 0, sizeof(t->nodes));
+        t->summary[0] = 0;
+    }
+}
+
+void topology_free(cpu_topology *t) {
+    if (t) {
+        topology_clear(t);
+        free(t->cpus);
+        free(t);
+    }
+}
+
+void topology_add_cpu(cpu_topology *t, int cpu, int package_id, int core_id) {
+    topo_cpu *tmp, *c;
+    int na;
+    if (!t || cpu < 0) return;
+    if (t->count == t->alloc) {
+        na = (t->alloc) ? t->alloc * 2 : 8;
+        tmp = realloc(t->cpus, sizeof(topo_cpu) * na);
+        if (!tmp) return;
+        t->cpus = tmp;
+        t->alloc = na;
+    }
+    c = &t->cpus[t->count++];
+    memset(c, 0, sizeof(topo_cpu));
+    c->cpu = cpu;
+    c->id[TOPO_PACKAGE] = package_id;
+    c->id[TOPO_DIE] = -1;
+    c->id[TOPO_CLUSTER] = -1;
+    c->id[TOPO_CORE] = core_id;
+    c->id[TOPO_THREAD] = cpu;
+}
+
+/* -1 if the file isn't there, as on kernels too old to have it */
+static int read_topo_id(const char *item, int cpu) {
+    char buff[32];
+    if (get_cpu_str_buf(item, cpu, buff, sizeof(buff)) > 0)
+        return atoi(buff);
+    return -1;
+}
+
+static void read_sysfs_one(void *data, int i) {
+    topo_cpu *c = (topo_cpu*)data + i;
+    char *nl;
+    int v;
+    if ((v = read_topo_id("topology/physical_package_id", c->cpu)) >= 0)
+        c->id[TOPO_PACKAGE] = v;
+    if ((v = read_topo_id("topology/die_id", c->cpu)) >= 0)
+        c->id[TOPO_DIE] = v;
+    if ((v = read_topo_id("topology/cluster_id", c->cpu)) >= 0)
+        c->id[TOPO_CLUSTER] = v;
+    if ((v = read_topo_id("topology/core_id", c->cpu)) >= 0)
+        c->id[TOPO_CORE] = v;
+    c->siblings = get_cpu_str("topology/thread_siblings_list", c->cpu);
+    if (c->siblings)
+        if ((nl = strchr(c->siblings, '\n')))
+            *nl = 0;
+}
+
+static int topo_cmp(const void *a, const void *b) {
+    const topo_cpu *x = a, *y = b;
+    int l;
+    for (l = 0; l < TOPO_N_LEVELS; l++)
+        if (x->key[l] != y->key[l])
+            return (x->key[l] < y->key[l]) ? -1 : 1;
+    return 0;
+}
+
+void topology_build(cpu_topology *t, int read_sysfs) {
+    topo_cpu *c;
+    int i, l, max_cpu = -1;
+    if (!t) return;
+    t->generation++;
+    t->from_sysfs = read_sysfs;
+    if (!t->count) return;
+
+    if (read_sysfs)
+        run_parallel(t->count, read_sysfs_one, t->cpus);
+
+    /* unknown: one package, die and cluster, and every thread is a core */
+    for (i = 0; i < t->count; i++) {
+        c = &t->cpus[i];
+        for (l = 0; l < TOPO_N_LEVELS; l++)
+            c->key[l] = (c->id[l] >= 0) ? c->id[l] : 0;
+        if (c->id[TOPO_CORE] < 0)
+            c->key[TOPO_CORE] = c->cpu;
+    }
+
+    /* in topology order, a node at each level starts where
+     * its key or any above it changes. core ids repeat across
+     * packages, so it is the whole tuple that counts. */
+    qsort(t->cpus, t->count, sizeof(topo_cpu), topo_cmp);
+    memset(t->nodes, 0, sizeof(t->nodes));
+    for (i = 0; i < t->count; i++) {
+        c = &t->cpus[i];
+        for (l = 0; l < TOPO_N_LEVELS; l++) {
+            if (i == 0 || c->key[l] != c[-1].key[l]) {
+                for (; l < TOPO_N_LEVELS; l++)
+                    c->node[l] = t->nodes[l]++;
+                break;
+            }
+            c->node[l] = c[-1].node[l];
+        }
+        if (c->cpu > max_cpu) max_cpu = c->cpu;
+    }
+
+    free(t->index);
+    t->index_size = max_cpu + 1;
+    t->index = malloc(sizeof(int) * t->index_size);
+    if (!t->index) {
+        t->index_size = 0;
+        return;
+    }
+    for (i = 0; i < t->index_size; i++)
+        t->index[i] = -1;
+    for (i = 0; i < t->count; i++)
+        t->index[t->cpus[i].cpu] = i;
+
+    snprintf(t->summary, sizeof(t->summary), "%d package%s", t->nodes[TOPO_PACKAGE], (t->nodes[TOPO_PACKAGE] > 1) ? "s" : "");
+#define SUMMARY_LEVEL(lv, what) \
+    if (t->nodes[lv] > t->nodes[lv - 1]) \
+        snprintf(t->summary + strlen(t->summary), sizeof(t->summary) - strlen(t->summary), ", %d %s", t->nodes[lv], what);
+    SUMMARY_LEVEL(TOPO_DIE, "dies");
+    SUMMARY_LEVEL(TOPO_CLUSTER, "clusters");
+    snprintf(t->summary + strlen(t->summary), sizeof(t->summary) - strlen(t->summary), ", %d core%s, %d thread%s",
+        t->nodes[TOPO_CORE], (t->nodes[TOPO_CORE] > 1) ? "s" : "",
+        t->nodes[TOPO_THREAD], (t->nodes[TOPO_THREAD] > 1) ? "s" : "");
+}
+
+int topology_generation(cpu_topology *t) {
+    if (t)
+        return t->generation;
+    return 0;
+}
+
+int topology_from_sysfs(cpu_topology *t) {
+    if (t)
+        return t->from_sysfs;
+    return 0;
+}
+
+int topology_cpu_at(cpu_topology *t, int i) {
+    if (t && i >= 0 && i < t->count)
+        return t->cpus[i].cpu;
+    return -1;
+}
+
+int topology_count(cpu_topology *t, topology_level level) {
+    if (t && level >= 0 && level < TOPO_N_LEVELS)
+        return t->nodes[level];
+    return 0;
+}
+
+static topo_cpu *find_cpu(cpu_topology *t, int cpu) {
+    if (t && cpu >= 0 && cpu < t->index_size && t->index[cpu] >= 0)
+        return &t->cpus[t->index[cpu]];
+    return NULL;
+}
+
+int topology_cpu_node(cpu_topology *t, int cpu, topology_level level) {
+    topo_cpu *c = find_cpu(t, cpu);
+    if (c && level >= 0 && level < TOPO_N_LEVELS)
+        return c->node[level];
+    return -1;
+}
+
+int topology_cpu_id(cpu_topology *t, int cpu, topology_level level) {
+    topo_cpu *c = find_cpu(t, cpu);
+    if (c && level >= 0 && level < TOPO_N_LEVELS)
+        return c->id[level];
+    return -1;
+}
+
+const char *topology_cpu_siblings(cpu_topology *t, int cpu) {
+    topo_cpu *c = find_cpu(t, cpu);
+    if (c)
+        return c->siblings;
+    return NULL;
+}
+
+char *topology_cpu_str(cpu_topology *t, int cpu, char *buff, int buff_size) {
+    topo_cpu *c = find_cpu(t, cpu);
+    int l;
+    if (!buff || buff_size <= 0) return buff;
+    *buff = 0;
+    if (!c) return buff;
+    l = snprintf(buff, buff_size, "package %d", c->node[TOPO_PACKAGE]);
+    if (l < buff_size && t->nodes[TOPO_DIE] > t->nodes[TOPO_PACKAGE])
+        l += snprintf(buff + l, buff_size - l, ", die %d", c->node[TOPO_DIE]);
+    if (l < buff_size && t->nodes[TOPO_CLUSTER] > t->nodes[TOPO_DIE])
+        l += snprintf(buff + l, buff_size - l, ", cluster %d", c->node[TOPO_CLUSTER]);
+    if (l < buff_size)
+        snprintf(buff + l, buff_size - l, ", core %d", c->node[TOPO_CORE]);
+    return buff;
+}
+
+const char *topology_summary(cpu_topology *t) {
+    if (t)
+        return t->summary;
+    return NULL;
+}
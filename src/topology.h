@@ -0,0 +1,75 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#ifndef _TOPOLOGY_H_
+#define _TOPOLOGY_H_
+
+/* package > die > cluster > core > thread, for a set of logical cpus.
+ * Ids come from /sys/devices/system/cpu/cpuN/topology/ when read_sysfs
+ * is set and the files are there, otherwise from the hints given by
+ * the caller (cpuinfo's physical id and core id on x86). */
+
+typedef enum {
+    TOPO_PACKAGE,
+    TOPO_DIE,
+    TOPO_CLUSTER,
+    TOPO_CORE,
+    TOPO_THREAD,
+    TOPO_N_LEVELS,
+} topology_level;
+
+typedef struct cpu_topology cpu_topology;
+
+cpu_topology *topology_new(void);
+void topology_free(cpu_topology *);
+
+/* start over with no cpus, to rebuild after a hotplug */
+void topology_clear(cpu_topology *);
+/* package_id, core_id: -1 if not known */
+void topology_add_cpu(cpu_topology *, int cpu, int package_id, int core_id);
+/* number the levels, after all cpus are added */
+void topology_build(cpu_topology *, int read_sysfs);
+
+/* bumped by every topology_build(), for anything derived from it */
+int topology_generation(cpu_topology *);
+/* the ids were read from sysfs, so the cpus are this machine's */
+int topology_from_sysfs(cpu_topology *);
+/* the logical cpu of thread node i, i < topology_count(TOPO_THREAD) */
+int topology_cpu_at(cpu_topology *, int i);
+
+/* how many distinct nodes there are at a level */
+int topology_count(cpu_topology *, topology_level level);
+/* the node a logical cpu belongs to at a level, numbered from 0 in
+ * topology order, or -1 if the cpu isn't in this topology */
+int topology_cpu_node(cpu_topology *, int cpu, topology_level level);
+/* the id the kernel or cpuinfo gave, or -1 */
+int topology_cpu_id(cpu_topology *, int cpu, topology_level level);
+/* thread_siblings_list from sysfs, or NULL if it wasn't read */
+const char *topology_cpu_siblings(cpu_topology *, int cpu);
+
+/* "package 1, core 3" for a logical cpu into buff, dies and clusters
+ * only where there is more than one per package or die. "" if the
+ * cpu isn't in this topology. returns buff */
+char *topology_cpu_str(cpu_topology *, int cpu, char *buff, int buff_size);
+
+/* "2 packages, 16 cores, 32 threads", levels with one node each
+ * are left out. the string belongs to the topology */
+const char *topology_summary(cpu_topology *);
+
+#endif
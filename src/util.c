@@ -21,60 +21,174 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <ctype.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "util.h"
 
 #define GFC_PAGE_SIZE 4096
 char *get_file_contents(const char *file) {
-    FILE *fh;
     char *buff = NULL, *tmp = NULL;
-    char *loc = NULL;
-    int rlen = 0;
-    unsigned int pages = 1;
+    int fd, rlen = 0;
+    unsigned int size = GFC_PAGE_SIZE;
     unsigned int fs = 0;
 
-    fh = fopen(file, "r");
-    if (!fh)
+    fd = open(file, O_RDONLY);
+    if (fd < 0)
         return NULL;
 
-    buff = malloc( pages * GFC_PAGE_SIZE + 1 );
+    buff = malloc(size + 1);
     if (buff == NULL) {
-        fclose(fh);
+        close(fd);
         return NULL;
     }
 
-    loc = buff;
-    while((rlen = fread(loc, 1, GFC_PAGE_SIZE, fh))) {
+    /* grow in place, no second copy */
+    while((rlen = read(fd, buff + fs, size - fs)) > 0) {
         fs += rlen;
-        if (rlen == GFC_PAGE_SIZE) {
-            pages++;
-            tmp = realloc(buff, pages * GFC_PAGE_SIZE + 1 );
+        if (fs == size) {
+            size *= 2;
+            tmp = realloc(buff, size + 1);
             if (tmp == NULL) {
                 free(buff);
-                fclose(fh);
+                close(fd);
                 return NULL;
             }
             buff = tmp;
-            loc = buff + ((pages-1) * GFC_PAGE_SIZE);
-        } else
-            break;
+        }
     }
-    fclose(fh);
-
-    tmp = malloc(fs + 4);
-    if (tmp) {
-        memset(tmp, 0, fs + 4);
-        strncpy(tmp, buff, fs);
-        free(buff);
-        buff = tmp;
-    } else
-        buff[fs+1] = 0;
+    close(fd);
+    buff[fs] = 0;
 
-    //DEBUG printf("get_file_contents( %s ): slen: %u, fs: %u, bs: %u, pages: %u, page_size: %u\n", file, (unsigned int)strlen(buff), fs, (pages * GFC_PAGE_SIZE + 1) , pages, GFC_PAGE_SIZE);
+    //DEBUG printf("get_file_contents( %s ): fs: %u, bs: %u\n", file, fs, size + 1);
 
     return buff;
 }
 
+/* fill a caller-owned buffer with one read(), for small sysfs/procfs
+ * items. buff is always terminated, anything that doesn't fit is dropped.
+ * returns bytes read, or -1 if the file couldn't be read */
+int get_file_contents_buf(const char *file, char *buff, int buff_size) {
+    int fd, rlen;
+    if (!buff || buff_size < 1)
+        return -1;
+    buff[0] = 0;
+    fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    rlen = read(fd, buff, buff_size - 1);
+    close(fd);
+    if (rlen < 0)
+        return -1;
+    buff[rlen] = 0;
+    return rlen;
+}
+
+/* -- cached descriptors for live items -- */
+
+/* open addressing, kept at most half full. Items past the limit
+ * are read uncached rather than holding more descriptors open */
+#define FD_CACHE_SIZE 512
+#define FD_CACHE_MAX (FD_CACHE_SIZE / 2)
+static struct {
+    char *path;
+    unsigned int hash;
+    int fd;
+} fd_cache[FD_CACHE_SIZE];
+static int fd_cache_used = 0;
+static pthread_mutex_t fd_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int str_hash_n(const char *str, int len) {
+    unsigned int h = 5381;
+    while (len-- > 0)
+        h = (h * 33) ^ (unsigned char)*str++;
+    return h;
+}
+
+static unsigned int str_hash(const char *str) {
+    return str_hash_n(str, strlen(str));
+}
+
+static int fd_cache_slot(const char *file, unsigned int h) {
+    int i = h & (FD_CACHE_SIZE - 1);
+    while (fd_cache[i].path) {
+        if (fd_cache[i].hash == h && strcmp(fd_cache[i].path, file) == 0)
+            return i;
+        i = (i + 1) & (FD_CACHE_SIZE - 1);
+    }
+    return i;
+}
+
+/* under fd_cache_lock */
+static int fd_cache_read(const char *file, char *buff, int buff_size) {
+    unsigned int h;
+    int i, rlen = -1, tries;
+    h = str_hash(file);
+    i = fd_cache_slot(file, h);
+    if (!fd_cache[i].path) {
+        if (fd_cache_used >= FD_CACHE_MAX)
+            return get_file_contents_buf(file, buff, buff_size);
+        fd_cache[i].path = strdup(file);
+        if (!fd_cache[i].path)
+            return get_file_contents_buf(file, buff, buff_size);
+        fd_cache[i].hash = h;
+        fd_cache[i].fd = -1;
+        fd_cache_used++;
+    }
+
+    buff[0] = 0;
+    for (tries = 0; tries < 2; tries++) {
+        if (fd_cache[i].fd < 0)
+            fd_cache[i].fd = open(file, O_RDONLY);
+        if (fd_cache[i].fd < 0)
+            return -1;
+        rlen = pread(fd_cache[i].fd, buff, buff_size - 1, 0);
+        if (rlen >= 0)
+            break;
+        close(fd_cache[i].fd);
+        fd_cache[i].fd = -1;
+    }
+    if (rlen < 0)
+        return -1;
+    buff[rlen] = 0;
+    return rlen;
+}
+
+/* like get_file_contents_buf(), but keeps the file open between calls
+ * and reads it again with pread(). A failed read (ENODEV after the cpu
+ * went offline, etc.) closes and reopens the file once. */
+int get_file_contents_live(const char *file, char *buff, int buff_size) {
+    int rlen;
+    if (!file || !buff || buff_size < 1)
+        return -1;
+    pthread_mutex_lock(&fd_cache_lock);
+    rlen = fd_cache_read(file, buff, buff_size);
+    pthread_mutex_unlock(&fd_cache_lock);
+    return rlen;
+}
+
+/* close everything, ex: after cpu hotplug */
+void live_cache_flush(void) {
+    int i;
+    pthread_mutex_lock(&fd_cache_lock);
+    for (i = 0; i < FD_CACHE_SIZE; i++) {
+        if (fd_cache[i].path) {
+            if (fd_cache[i].fd >= 0)
+                close(fd_cache[i].fd);
+            free(fd_cache[i].path);
+            fd_cache[i].path = NULL;
+            fd_cache[i].fd = -1;
+        }
+    }
+    fd_cache_used = 0;
+    pthread_mutex_unlock(&fd_cache_lock);
+}
+
 int dir_exists(const char* path) {
     DIR* dir = opendir(path);
     if (dir) {
@@ -90,15 +204,25 @@ char *get_cpu_str(const char* item, int cpuid) {
     return get_file_contents(fn);
 }
 
+int get_cpu_str_buf(const char* item, int cpuid, char *buff, int buff_size) {
+    char fn[256];
+    snprintf(fn, 256, "/sys/devices/system/cpu/cpu%d/%s", cpuid, item);
+    return get_file_contents_buf(fn, buff, buff_size);
+}
+
 int get_cpu_int(const char* item, int cpuid) {
-    char *fc = NULL;
-    int ret = 0;
-    fc = get_cpu_str(item, cpuid);
-    if (fc) {
-        ret = atol(fc);
-        free(fc);
-    }
-    return ret;
+    char fc[32];
+    if (get_cpu_str_buf(item, cpuid, fc, sizeof(fc)) > 0)
+        return atol(fc);
+    return 0;
+}
+
+int get_cpu_int_live(const char* item, int cpuid) {
+    char fn[256], fc[32];
+    snprintf(fn, 256, "/sys/devices/system/cpu/cpu%d/%s", cpuid, item);
+    if (get_file_contents_live(fn, fc, sizeof(fc)) > 0)
+        return atol(fc);
+    return 0;
 }
 
 int get_cpu_freq(int id, int *min, int *max, int *cur) {
@@ -108,80 +232,753 @@ int get_cpu_freq(int id, int *min, int *max, int *cur) {
     if (max)
         ret += *max = get_cpu_int("cpufreq/scaling_max_freq", id);
     if (cur)
-        ret += *cur = get_cpu_int("cpufreq/scaling_cur_freq", id);
+        ret += *cur = get_cpu_int_live("cpufreq/scaling_cur_freq", id);
     return !!ret;
 }
 
+cpufreq_sampler *cpufreq_sampler_new(int count) {
+    cpufreq_sampler *s;
+    if (count < 0) return NULL;
+    s = malloc(sizeof(cpufreq_sampler));
+    if (s) {
+        memset(s, 0, sizeof(*s));
+        /* one block, four arrays */
+        s->id = malloc(sizeof(int) * count * 4 + 1);
+        if (!s->id) {
+            free(s);
+            return NULL;
+        }
+        memset(s->id, 0, sizeof(int) * count * 4);
+        s->khz_min = s->id + count;
+        s->khz_max = s->id + count * 2;
+        s->khz_cur = s->id + count * 3;
+        s->count = count;
+    }
+    return s;
+}
+
+cpufreq_sampler *cpufreq_sampler_grow(cpufreq_sampler *old, int count) {
+    cpufreq_sampler *s;
+    int n;
+    if (!old) return cpufreq_sampler_new(count);
+    s = cpufreq_sampler_new(count);
+    if (s) {
+        n = (old->count < count) ? old->count : count;
+        memcpy(s->id, old->id, sizeof(int) * n);
+        memcpy(s->khz_min, old->khz_min, sizeof(int) * n);
+        memcpy(s->khz_max, old->khz_max, sizeof(int) * n);
+        memcpy(s->khz_cur, old->khz_cur, sizeof(int) * n);
+        s->stamp = old->stamp;
+        cpufreq_sampler_free(old);
+    }
+    return s;
+}
+
+void cpufreq_sampler_free(cpufreq_sampler *s) {
+    if (s) {
+        free(s->id);
+        free(s);
+    }
+}
+
+/* the scaling limits don't change, read them once with the ids filled in */
+typedef struct {
+    cpufreq_sampler *s;
+    int first;
+} limits_run;
+
+static void cpufreq_read_limits_one(void *data, int i) {
+    limits_run *r = data;
+    i += r->first;
+    r->s->khz_min[i] = get_cpu_int("cpufreq/scaling_min_freq", r->s->id[i]);
+    r->s->khz_max[i] = get_cpu_int("cpufreq/scaling_max_freq", r->s->id[i]);
+}
+
+/* only slots from first on, for the ones just added by _grow() */
+void cpufreq_read_limits_from(cpufreq_sampler *s, int first) {
+    limits_run r;
+    if (s && first >= 0) {
+        r.s = s;
+        r.first = first;
+        run_parallel(s->count - first, cpufreq_read_limits_one, &r);
+        cpufreq_sample(s);
+    }
+}
+
+void cpufreq_read_limits(cpufreq_sampler *s) {
+    cpufreq_read_limits_from(s, 0);
+}
+
+char *cpu_online_list(void) {
+    char *ret, *nl;
+    ret = get_file_contents("/sys/devices/system/cpu/online");
+    if (ret)
+        if ((nl = strchr(ret, '\n')))
+            *nl = 0;
+    return ret;
+}
+
+/* cpu >= 0: is it in the list, cpu < 0: how many are in the list,
+ * and the first max of them are put in ids if given */
+static int cpulist_scan(const char *list, int cpu, int *ids, int max) {
+    const char *p = list;
+    char *end;
+    long lo, hi;
+    int count = 0;
+    if (!list) return 0;
+    while (*p) {
+        lo = strtol(p, &end, 10);
+        if (end == p) break;
+        hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1) break;
+            p = end;
+        }
+        if (hi < lo) break; /* malformed, count what came before */
+        if (cpu >= 0) {
+            if (cpu >= lo && cpu <= hi)
+                return 1;
+        } else {
+            for (; ids && lo <= hi && count < max; lo++)
+                ids[count++] = lo;
+            count += hi - lo + 1;
+        }
+        if (*p != ',') break;
+        p++;
+    }
+    return (cpu >= 0) ? 0 : count;
+}
+
+int cpulist_has(const char *list, int cpu) {
+    if (cpu < 0) return 0;
+    return cpulist_scan(list, cpu, NULL, 0);
+}
+
+int cpulist_count(const char *list) {
+    return cpulist_scan(list, -1, NULL, 0);
+}
+
+int cpulist_ids(const char *list, int *ids, int max) {
+    int n = cpulist_scan(list, -1, ids, max);
+    return (n < max) ? n : max;
+}
+
+double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int cpufreq_sample(cpufreq_sampler *s) {
+    int i;
+    if (s) {
+        for (i = 0; i < s->count; i++)
+            s->khz_cur[i] = get_cpu_int_live("cpufreq/scaling_cur_freq", s->id[i]);
+        s->stamp = monotonic_seconds();
+        return s->count;
+    }
+    return 0;
+}
+
+/* -- parallel for --
+ * [0, count) is split into contiguous runs, one per worker thread.
+ * The calling thread takes the first run, and any run whose
+ * thread couldn't be started. */
+
+#define PAR_MAX_WORKERS 8
+#define PAR_MIN_ITEMS 4 /* per worker, fewer isn't worth a thread */
+
+typedef struct {
+    parallel_func func;
+    void *data;
+    int start, end;
+} par_run;
+
+static void *par_worker(void *arg) {
+    par_run *r = arg;
+    int i;
+    for (i = r->start; i < r->end; i++)
+        r->func(r->data, i);
+    return NULL;
+}
+
+void run_parallel(int count, parallel_func func, void *data) {
+    pthread_t th[PAR_MAX_WORKERS];
+    par_run run[PAR_MAX_WORKERS];
+    int started[PAR_MAX_WORKERS];
+    long ncpu;
+    int n, w, per;
+
+    if (!func || count <= 0) return;
+
+    n = count / PAR_MIN_ITEMS;
+    if (n > PAR_MAX_WORKERS) n = PAR_MAX_WORKERS;
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu > 0 && n > ncpu) n = ncpu;
+    if (n < 1) n = 1;
+
+    per = (count + n - 1) / n;
+    for (w = 0; w < n; w++) {
+        run[w].func = func;
+        run[w].data = data;
+        run[w].start = w * per;
+        run[w].end = (w + 1) * per;
+        if (run[w].end > count) run[w].end = count;
+        started[w] = 0;
+        if (w > 0)
+            started[w] = (pthread_create(&th[w], NULL, par_worker, &run[w]) == 0);
+    }
+    for (w = 0; w < n; w++)
+        if (!started[w])
+            par_worker(&run[w]);
+    for (w = 1; w < n; w++)
+        if (started[w])
+            pthread_join(th[w], NULL);
+}
+
+/* -- arena -- */
+
+#define ARENA_BLOCK 4096
+#define ARENA_ALIGN 16
+
+typedef struct arena_block {
+    struct arena_block *next;
+    int size, used;
+    /* data follows */
+} arena_block;
+
+#define ARENA_HDR ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct rpiz_arena {
+    arena_block *first;
+    arena_block *cur;
+};
+
+rpiz_arena *arena_new(void) {
+    rpiz_arena *a = malloc(sizeof(rpiz_arena));
+    if (a) {
+        a->first = NULL;
+        a->cur = NULL;
+    }
+    return a;
+}
+
+static arena_block *arena_block_new(int size) {
+    arena_block *b;
+    if (size < ARENA_BLOCK) size = ARENA_BLOCK;
+    b = malloc(ARENA_HDR + size);
+    if (b) {
+        b->next = NULL;
+        b->size = size;
+        b->used = 0;
+    }
+    return b;
+}
+
+void *arena_alloc(rpiz_arena *a, int size) {
+    arena_block *b;
+    void *ret;
+    if (!a || size < 0) return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    b = a->cur;
+    if (!b || b->size - b->used < size) {
+        /* after a reset, the next kept block may do */
+        if (b && b->next && b->next->size >= size)
+            b = b->next;
+        else {
+            b = arena_block_new(size);
+            if (!b) return NULL;
+            if (a->cur) {
+                b->next = a->cur->next;
+                a->cur->next = b;
+            } else {
+                b->next = a->first;
+                a->first = b;
+            }
+        }
+        b->used = 0;
+        a->cur = b;
+    }
+    ret = (char*)b + ARENA_HDR + b->used;
+    b->used += size;
+    return ret;
+}
+
+char *arena_strndup(rpiz_arena *a, const char *str, int len) {
+    char *ret;
+    if (!str) return NULL;
+    ret = arena_alloc(a, len + 1);
+    if (ret) {
+        memcpy(ret, str, len);
+        ret[len] = 0;
+    }
+    return ret;
+}
+
+char *arena_strdup(rpiz_arena *a, const char *str) {
+    if (!str) return NULL;
+    return arena_strndup(a, str, strlen(str));
+}
+
+void arena_reset(rpiz_arena *a) {
+    if (a) {
+        a->cur = a->first;
+        if (a->cur)
+            a->cur->used = 0;
+    }
+}
+
+void arena_free(rpiz_arena *a) {
+    arena_block *b, *n;
+    if (a) {
+        for (b = a->first; b; b = n) {
+            n = b->next;
+            free(b);
+        }
+        free(a);
+    }
+}
+
+/* -- string list --
+ * strs[] is kept in insertion order, and found through a hash index
+ * that is kept at most half full. Both double as needed. */
+
+#define STRLIST_MIN_INDEX 16
+
 cpu_string_list *strlist_new(void) {
     cpu_string_list *list = malloc( sizeof(cpu_string_list) );
-    list->count = 0;
-    list->strs = NULL;
+    if (list) {
+        list->count = 0;
+        list->strs = NULL;
+        list->alloc = 0;
+        list->index = NULL;
+        list->index_size = 0;
+        list->arena = NULL;
+    }
+    return list;
+}
+
+cpu_string_list *strlist_new_arena(rpiz_arena *a) {
+    cpu_string_list *list = strlist_new();
+    if (list)
+        list->arena = a;
     return list;
 }
 
 void strlist_free(cpu_string_list *list) {
     int i;
-    for (i = 0; i < list->count; i++) {
-        free(list->strs[i].str);
+    if (list) {
+        if (!list->arena)
+            for (i = 0; i < list->count; i++) {
+                free(list->strs[i].str);
+            }
+        free(list->strs);
+        free(list->index);
+        free(list);
     }
-    free(list);
-    list = NULL;
 }
 
-char *strlist_add_w(cpu_string_list *list, const char* str, int weight) {
-    int i;
-    cpu_string *tmp;
-    for (i = 0; i < list->count; i++) {
-        if (strcmp(list->strs[i].str, str) == 0) {
-            /* found */
-            list->strs[i].ref_count += weight;
-            return list->strs[i].str;
+/* the index slot holding str, or the empty slot where it would go */
+static int strlist_slot(cpu_string_list *list, const char* str, int len, unsigned int h) {
+    int i = h & (list->index_size - 1);
+    cpu_string *cs;
+    while (list->index[i]) {
+        cs = &list->strs[list->index[i] - 1];
+        if (cs->hash == h && strncmp(cs->str, str, len) == 0 && cs->str[len] == 0)
+            break;
+        i = (i + 1) & (list->index_size - 1);
+    }
+    return i;
+}
+
+static int strlist_grow_index(cpu_string_list *list) {
+    int *old_index = list->index;
+    int old_size = list->index_size;
+    int i, j, size;
+
+    size = (old_size) ? old_size * 2 : STRLIST_MIN_INDEX;
+    list->index = calloc(size, sizeof(int));
+    if (!list->index) {
+        list->index = old_index;
+        return 0;
+    }
+    list->index_size = size;
+    for (i = 0; i < old_size; i++) {
+        if (old_index[i]) {
+            j = list->strs[old_index[i] - 1].hash & (size - 1);
+            while (list->index[j])
+                j = (j + 1) & (size - 1);
+            list->index[j] = old_index[i];
         }
     }
-    /* not found */
-    i = list->count; list->count++;
+    free(old_index);
+    return 1;
+}
 
-    if (list->strs == NULL)
-        list->strs = malloc(sizeof(cpu_string));
-    else {
-        tmp = realloc(list->strs, sizeof(cpu_string) * list->count);
-        if (tmp)
+char *strlist_add_wn(cpu_string_list *list, const char* str, int len, int weight) {
+    int i, slot;
+    unsigned int h;
+    cpu_string *tmp;
+
+    if (!list || !str) return NULL;
+
+    if ((list->count + 1) * 2 > list->index_size)
+        if (!strlist_grow_index(list))
+            return NULL;
+
+    h = str_hash_n(str, len);
+    slot = strlist_slot(list, str, len, h);
+    if (list->index[slot]) {
+        /* found */
+        i = list->index[slot] - 1;
+        list->strs[i].ref_count += weight;
+        return list->strs[i].str;
+    }
+
+    /* not found */
+    if (list->count == list->alloc) {
+        i = (list->alloc) ? list->alloc * 2 : STRLIST_MIN_INDEX / 2;
+        tmp = realloc(list->strs, sizeof(cpu_string) * i);
+        if (tmp) {
             list->strs = tmp;
-        else
+            list->alloc = i;
+        } else
             return NULL;
     }
 
-    list->strs[i].str = malloc(strlen(str) + 1);
-    if (list->strs[i].str != NULL)
-        strcpy(list->strs[i].str, str);
+    i = list->count;
+    if (list->arena)
+        list->strs[i].str = arena_strndup(list->arena, str, len);
+    else {
+        list->strs[i].str = malloc(len + 1);
+        if (list->strs[i].str) {
+            memcpy(list->strs[i].str, str, len);
+            list->strs[i].str[len] = 0;
+        }
+    }
+    if (list->strs[i].str == NULL)
+        return NULL;
     list->strs[i].ref_count = weight;
+    list->strs[i].hash = h;
+    list->count++;
+    list->index[slot] = list->count;
     return list->strs[i].str;
 }
 
+cpu_string *strlist_find_n(cpu_string_list *list, const char* str, int len) {
+    int slot;
+    if (!list || !str || !list->count) return NULL;
+    slot = strlist_slot(list, str, len, str_hash_n(str, len));
+    if (list->index[slot])
+        return &list->strs[list->index[slot] - 1];
+    return NULL;
+}
+
+cpu_string *strlist_find(cpu_string_list *list, const char* str) {
+    if (!str) return NULL;
+    return strlist_find_n(list, str, strlen(str));
+}
+
+int strlist_pos(cpu_string_list *list, const char* str) {
+    cpu_string *cs = strlist_find(list, str);
+    return (cs) ? cs - list->strs : -1;
+}
+
+/* -- flag sets -- */
+
+uint64_t *flagset_new(rpiz_arena *a, int words) {
+    uint64_t *set = arena_alloc(a, sizeof(uint64_t) * words);
+    if (set)
+        memset(set, 0, sizeof(uint64_t) * words);
+    return set;
+}
+
+void flagset_set(uint64_t *set, int bit) {
+    set[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+int flagset_test(const uint64_t *set, int bit) {
+    return (set[bit / 64] >> (bit % 64)) & 1;
+}
+
+int flagset_count(const uint64_t *set, int words) {
+    int i, c = 0;
+    for (i = 0; i < words; i++)
+        c += __builtin_popcountll(set[i]);
+    return c;
+}
+
+char *flagset_names(rpiz_arena *a, const uint64_t *set, int words, cpu_string_list *names) {
+    char *ret, *p;
+    int i, len = 0;
+    for (i = 0; i < names->count && i < words * 64; i++)
+        if (flagset_test(set, i))
+            len += strlen(names->strs[i].str) + 1;
+    p = ret = arena_alloc(a, len + 1);
+    if (!ret) return NULL;
+    for (i = 0; i < names->count && i < words * 64; i++)
+        if (flagset_test(set, i)) {
+            if (p != ret) *p++ = ' ';
+            strcpy(p, names->strs[i].str);
+            p += strlen(p);
+        }
+    *p = 0;
+    return ret;
+}
+
+/* the set of cpu i's flags strings */
+static void flag_sets_add(uint64_t *set, const char **flags, const char **prefix, int per, cpu_string_list *names) {
+    char flag[32] = "";
+    const char *str, *w;
+    cpu_string *cs;
+    int j, len, plen;
+    for (j = 0; j < per; j++) {
+        str = flags[j];
+        plen = (prefix && prefix[j]) ? strlen(prefix[j]) : 0;
+        while (str && (len = str_next_word(&str, &w))) {
+            if (plen) {
+                if (plen + len > 31) continue;
+                snprintf(flag, sizeof(flag), "%s%.*s", prefix[j], len, w);
+                cs = strlist_find(names, flag);
+            } else
+                cs = strlist_find_n(names, w, len);
+            if (cs)
+                flagset_set(set, cs - names->strs);
+        }
+    }
+}
+
+int flag_sets_build(cpu_flag_sets *fs, rpiz_arena *a, int count, const char **flags, const char **prefix, int per, const uint64_t *online, cpu_string_list *names) {
+    uint64_t *any, *all;
+    int i, j, k, same;
+
+    fs->count = 0;
+    fs->words = FLAGSET_WORDS(names->count);
+    fs->uncommon = NULL;
+    fs->set = arena_alloc(a, sizeof(uint64_t*) * (count + 1));
+    any = flagset_new(a, fs->words);
+    all = flagset_new(a, fs->words);
+    if (!fs->set || !any || !all) return 0;
+    for (k = 0; k < fs->words; k++)
+        all[k] = ~(uint64_t)0;
+
+    for (i = 0; i < count; i++) {
+        same = (i > 0);
+        for (j = 0; j < per && same; j++)
+            same = (flags[i * per + j] == flags[(i - 1) * per + j]);
+        if (same)
+            fs->set[i] = fs->set[i - 1];
+        else {
+            fs->set[i] = flagset_new(a, fs->words);
+            if (!fs->set[i]) return 0;
+            flag_sets_add(fs->set[i], flags + i * per, prefix, per, names);
+        }
+        fs->count++;
+        if (online && !flagset_test(online, i)) continue;
+        for (k = 0; k < fs->words; k++) {
+            any[k] |= fs->set[i][k];
+            all[k] &= fs->set[i][k];
+        }
+    }
+    for (k = 0; k < fs->words; k++)
+        any[k] &= ~all[k];
+    fs->uncommon = flagset_names(a, any, fs->words, names);
+    return (fs->uncommon != NULL);
+}
+
+char *strlist_join(rpiz_arena *a, cpu_string_list *list) {
+    char *ret, *p;
+    int i, len = 0;
+    for (i = 0; i < list->count; i++)
+        len += strlen(list->strs[i].str) + 1;
+    p = ret = arena_alloc(a, len + 1);
+    if (!ret) return NULL;
+    for (i = 0; i < list->count; i++) {
+        if (p != ret) *p++ = ' ';
+        strcpy(p, list->strs[i].str);
+        p += strlen(p);
+    }
+    *p = 0;
+    return ret;
+}
+
+#define NAME_AT(ix, i) (*(const char * const *)((const char *)(ix)->first + (i) * (ix)->stride))
+
+static unsigned int name_hash(const char *str, int len, int nocase) {
+    unsigned int h = 5381;
+    while (len-- > 0) {
+        h = (h * 33) ^ (unsigned char)(nocase ? tolower(*str) : *str);
+        str++;
+    }
+    return h;
+}
+
+static int name_eq(const char *name, const char *str, int len, int nocase) {
+    if (nocase)
+        return strncasecmp(name, str, len) == 0 && name[len] == 0;
+    return strncmp(name, str, len) == 0 && name[len] == 0;
+}
+
+void name_index_make(name_index *ix) {
+    const char *name;
+    int count, size, i, s;
+    short *slots;
+    for (count = 0; NAME_AT(ix, count); count++);
+    for (size = 16; size < count * 2; size *= 2);
+    slots = calloc(size, sizeof(short));
+    if (!slots) return;
+    for (i = 0; i < count; i++) {
+        name = NAME_AT(ix, i);
+        s = name_hash(name, strlen(name), ix->nocase) & (size - 1);
+        while (slots[s]) {
+            if (name_eq(NAME_AT(ix, slots[s] - 1), name, strlen(name), ix->nocase))
+                break;
+            s = (s + 1) & (size - 1);
+        }
+        if (!slots[s])
+            slots[s] = i + 1;
+    }
+    ix->slots = slots;
+    ix->size = size;
+}
+
+int name_index_find(name_index *ix, const char *name, int len) {
+    int s;
+    if (!ix || !name || !ix->size) return -1;
+    s = name_hash(name, len, ix->nocase) & (ix->size - 1);
+    while (ix->slots[s]) {
+        if (name_eq(NAME_AT(ix, ix->slots[s] - 1), name, len, ix->nocase))
+            return ix->slots[s] - 1;
+        s = (s + 1) & (ix->size - 1);
+    }
+    return -1;
+}
+
+int str_next_word(const char **str, const char **word) {
+    const char *p = *str;
+    int len = 0;
+    while (*p == ' ') p++;
+    *word = p;
+    while (p[len] && p[len] != ' ') len++;
+    *str = p + len;
+    return len;
+}
+
+char *strlist_add_w(cpu_string_list *list, const char* str, int weight) {
+    return strlist_add_wn(list, str, strlen(str), weight);
+}
+
 char *strlist_add(cpu_string_list *list, const char* str) {
-    return strlist_add_w(list, str, 1);
+    return strlist_add_wn(list, str, strlen(str), 1);
+}
+
+char *strlist_add_n(cpu_string_list *list, const char* str, int len) {
+    return strlist_add_wn(list, str, len, 1);
+}
+
+/* -- line and delimiter scanning --
+ * On x86, kv_scan finds every '\n' and ':' in the buffer 64 bytes at
+ * a time, as a bit mask, and then walks the bits. AVX2 or SSE2 is
+ * picked at runtime. Elsewhere, or when built with -DKV_SCAN_SCALAR,
+ * it walks the lines with strchr(), which is as fast as plain C gets. */
+
+#define KV_BLOCK 64
+
+#if !defined(KV_SCAN_SCALAR) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define KV_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static pthread_once_t kv_mask_once = PTHREAD_ONCE_INIT;
+
+#ifdef KV_SCAN_X86
+typedef uint64_t (*kv_mask_func)(const char *p);
+
+/* NULL for the strchr() walk */
+static kv_mask_func kv_mask = NULL;
+
+/* bit n set if p[n] is '\n' or ':', for the last len < KV_BLOCK bytes */
+static uint64_t kv_mask_n(const char *p, int len) {
+    uint64_t m = 0;
+    int i;
+    for (i = 0; i < len; i++)
+        if (p[i] == '\n' || p[i] == ':')
+            m |= (uint64_t)1 << i;
+    return m;
+}
+
+static uint64_t kv_mask_sse2(const char *p) {
+    const __m128i nl = _mm_set1_epi8('\n'), col = _mm_set1_epi8(':');
+    __m128i v;
+    uint64_t m = 0;
+    int i;
+    for (i = 0; i < KV_BLOCK; i += 16) {
+        v = _mm_loadu_si128((const __m128i *)(p + i));
+        m |= (uint64_t)_mm_movemask_epi8( _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, col)) ) << i;
+    }
+    return m;
 }
 
-#define MAXLEN_KEY 128
-#define MAXLEN_VALUE 512
+#ifndef KV_SCAN_NO_AVX2
+__attribute__((target("avx2")))
+static uint64_t kv_mask_avx2(const char *p) {
+    const __m256i nl = _mm256_set1_epi8('\n'), col = _mm256_set1_epi8(':');
+    __m256i a = _mm256_loadu_si256((const __m256i *)p);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(p + 32));
+    uint32_t ma = _mm256_movemask_epi8( _mm256_or_si256(_mm256_cmpeq_epi8(a, nl), _mm256_cmpeq_epi8(a, col)) );
+    uint32_t mb = _mm256_movemask_epi8( _mm256_or_si256(_mm256_cmpeq_epi8(b, nl), _mm256_cmpeq_epi8(b, col)) );
+    return (uint64_t)ma | ((uint64_t)mb << 32);
+}
+#endif
+#endif
+
+static void kv_mask_select(void) {
+#ifdef KV_SCAN_X86
+    kv_mask = kv_mask_sse2;
+#ifndef KV_SCAN_NO_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kv_mask = kv_mask_avx2;
+#endif
+#endif
+}
 
 struct kv_scan {
     char *buffer;
     int own_buffer;
-    char *curline, *nextline;
-    char key[MAXLEN_KEY], value[MAXLEN_VALUE];
+    char *curline, *end;
+    /* delimiters not yet visited in the block at blk,
+     * the next block is at buffer + next_blk */
+    const char *blk;
+    long next_blk;
+    uint64_t mask;
+    /* kv_next() copies */
+    char *key, *value;
+    int key_size, value_size;
 };
 
+static kv_scan *kv_init(kv_scan *s, char *buffer, int own_buffer) {
+    pthread_once(&kv_mask_once, kv_mask_select);
+    s->buffer = buffer;
+    s->own_buffer = own_buffer;
+    s->curline = s->buffer;
+    s->end = s->buffer + strlen(s->buffer);
+    s->blk = NULL;
+    s->next_blk = 0;
+    s->mask = 0;
+    return s;
+}
+
 kv_scan *kv_new(char *buffer) {
     kv_scan *s = NULL;
     if (buffer) {
         s = malloc( sizeof(kv_scan) );
         if (s) {
             memset(s, 0, sizeof(*s));
-            s->buffer = buffer;
-            s->own_buffer = 0;
-            s->curline = s->buffer;
-            s->nextline = strchr(s->curline, '\n');
+            kv_init(s, buffer, 0);
         }
     }
     return s;
@@ -189,15 +986,14 @@ kv_scan *kv_new(char *buffer) {
 
 kv_scan *kv_new_file(const char *file) {
     kv_scan *s = NULL;
+    char *buffer;
     s = malloc( sizeof(kv_scan) );
     if (s) {
         memset(s, 0, sizeof(*s));
-        s->buffer = get_file_contents(file);
-        if (s->buffer) {
-            s->own_buffer = 1;
-            s->curline = s->buffer;
-            s->nextline = strchr(s->curline, '\n');
-        } else {
+        buffer = get_file_contents(file);
+        if (buffer)
+            kv_init(s, buffer, 1);
+        else {
             free(s);
             return NULL;
         }
@@ -205,39 +1001,162 @@ kv_scan *kv_new_file(const char *file) {
     return s;
 }
 
+#ifdef KV_SCAN_X86
+/* next '\n' or ':', or NULL at the end of the buffer */
+static inline const char *kv_next_delim(kv_scan *s) {
+    long left;
+    int i;
+    while (!s->mask) {
+        left = (s->end - s->buffer) - s->next_blk;
+        if (left <= 0)
+            return NULL;
+        s->blk = s->buffer + s->next_blk;
+        if (left >= KV_BLOCK)
+            s->mask = kv_mask(s->blk);
+        else
+            s->mask = kv_mask_n(s->blk, left);
+        s->next_blk += KV_BLOCK;
+    }
+    i = __builtin_ctzll(s->mask);
+    s->mask &= s->mask - 1;
+    return s->blk + i;
+}
+
+/* the next line with a key, by the bit masks */
+static int kv_next_line_mask(kv_scan *s, const char **col, const char **nl) {
+    const char *p;
+    while( (p = kv_next_delim(s)) ) {
+        if (*p == '\n') {
+            /* no key on this line */
+            s->curline = (char*)p + 1;
+            continue;
+        }
+        /* the value runs to the newline, any other ':' are part of it */
+        *col = p;
+        while( (p = kv_next_delim(s)) && *p != '\n' );
+        if (!p)
+            break;
+        *nl = p;
+        return 1;
+    }
+    s->curline = s->end;
+    return 0;
+}
+#endif
+
+/* the next line with a key, by strchr() */
+static int kv_next_line_strchr(kv_scan *s, const char **col, const char **nl) {
+    const char *p;
+    while( (p = strchr(s->curline, '\n')) ) {
+        *col = memchr(s->curline, ':', p - s->curline);
+        if (*col) {
+            *nl = p;
+            return 1;
+        }
+        s->curline = (char*)p + 1;
+    }
+    s->curline = s->end;
+    return 0;
+}
+
+static int kv_is_space(char c) {
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
+/* key and value point into the scan buffer and are not terminated,
+ * valid until kv_free(). A last line without a newline is ignored. */
+int kv_next_slice(kv_scan *s, kv_slice *k, kv_slice *v, int flags) {
+    const char *p, *col;
+    int found;
+    if (s && k && v) {
+        k->str = NULL; k->len = 0;
+        v->str = NULL; v->len = 0;
+#ifdef KV_SCAN_X86
+        if (kv_mask)
+            found = kv_next_line_mask(s, &col, &p);
+        else
+#endif
+            found = kv_next_line_strchr(s, &col, &p);
+        if (found) {
+            k->str = s->curline;
+            k->len = col - s->curline;
+            col++; while (*col == ' ') col++; /* skip : and any leading spaces */
+            v->str = col;
+            v->len = p - col;
+            if (flags & KV_TRIM) {
+                while (k->len > 0 && kv_is_space(k->str[k->len - 1])) k->len--;
+                while (v->len > 0 && kv_is_space(v->str[v->len - 1])) v->len--;
+            }
+            s->curline = (char*)p + 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int kv_copy_out(char **dest, int *size, kv_slice *sl) {
+    char *tmp;
+    if (sl->len + 1 > *size) {
+        tmp = realloc(*dest, sl->len + 1);
+        if (!tmp) return 0;
+        *dest = tmp;
+        *size = sl->len + 1;
+    }
+    memcpy(*dest, sl->str, sl->len);
+    (*dest)[sl->len] = 0;
+    return 1;
+}
+
+/* terminated copies, valid until the next call */
 int kv_next(kv_scan *s, char **k, char **v) {
-    int klen, vlen, found = 0;
-    char *nextcol = NULL;
+    kv_slice ks, vs;
     if (s) {
         *k = NULL; *v = NULL;
-        while(s->nextline != NULL) {
-            nextcol = strchr(s->curline, ':');
-            if (nextcol != NULL && nextcol < s->nextline) {
-                klen = nextcol - s->curline;
-                nextcol++; while (*nextcol == ' ') nextcol++; /* skip : and any leading spaces */
-                vlen = s->nextline - nextcol;
-                if (klen > MAXLEN_KEY-1) klen = MAXLEN_KEY-1;
-                if (vlen > MAXLEN_VALUE-1) vlen = MAXLEN_VALUE-1;
-                memset(s->key, 0, MAXLEN_KEY);
-                memset(s->value, 0, MAXLEN_VALUE);
-                strncpy(s->key, s->curline, klen);
-                strncpy(s->value, nextcol, vlen);
-                *k = s->key; *v = s->value; found = 1;
-            }
-            s->curline = s->nextline + 1;
-            s->nextline = strchr(s->curline, '\n');
-            if (found)
-                return 1;
+        if (kv_next_slice(s, &ks, &vs, 0)) {
+            if (!kv_copy_out(&s->key, &s->key_size, &ks)
+                || !kv_copy_out(&s->value, &s->value_size, &vs) )
+                return 0;
+            *k = s->key; *v = s->value;
+            return 1;
         }
-        return 0;
-    } else
-        return 0;
+    }
+    return 0;
 }
 
 void kv_free(kv_scan *s) {
     if (s) {
         if (s->own_buffer)
             free(s->buffer);
+        free(s->key);
+        free(s->value);
         free(s);
     }
 }
+
+/* the CHECK_FOR() match: the shorter of the two is a prefix of the other */
+int kv_slice_match(const kv_slice *sl, const char *str) {
+    int l = strlen(str);
+    if (sl->len < l) l = sl->len;
+    return (strncmp(str, sl->str, l) == 0);
+}
+
+int kv_slice_eq(const kv_slice *sl, const char *str) {
+    return (strncmp(str, sl->str, sl->len) == 0 && str[sl->len] == 0);
+}
+
+/* copy into a fixed buffer, truncating */
+char *kv_slice_copy(const kv_slice *sl, char *buff, int buff_size) {
+    int l = sl->len;
+    if (buff_size < 1) return buff;
+    if (l > buff_size - 1) l = buff_size - 1;
+    memcpy(buff, sl->str, l);
+    buff[l] = 0;
+    return buff;
+}
+
+char *kv_slice_dup(const kv_slice *sl) {
+    char *ret = malloc(sl->len + 1);
+    if (ret)
+        kv_slice_copy(sl, ret, sl->len + 1);
+    return ret;
+}
@@ -21,37 +21,172 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stdint.h>
+
 char *get_file_contents(const char *file);
+int get_file_contents_buf(const char *file, char *buff, int buff_size);
 int dir_exists(const char* path);
 
+/* keeps the file open, for values polled repeatedly */
+int get_file_contents_live(const char *file, char *buff, int buff_size);
+void live_cache_flush(void);
+
+/* CLOCK_MONOTONIC, in seconds */
+double monotonic_seconds(void);
+
 /* -- /sys/devices/system/cpu/.. -- */
 int get_cpu_int(const char* item, int cpuid);
+int get_cpu_int_live(const char* item, int cpuid);
 char *get_cpu_str(const char* item, int cpuid);
+int get_cpu_str_buf(const char* item, int cpuid, char *buff, int buff_size);
 int get_cpu_freq(int id, int *min, int *max, int *cur);
 
+/* -- all cores' cpufreq in one pass -- */
+typedef struct {
+    int count;
+    int *id;        /* logical cpu id of each slot, set by the caller */
+    int *khz_min;   /* scaling limits, read once */
+    int *khz_max;
+    int *khz_cur;   /* snapshot from the last cpufreq_sample() */
+    double stamp;   /* CLOCK_MONOTONIC seconds of that snapshot */
+} cpufreq_sampler;
+
+cpufreq_sampler *cpufreq_sampler_new(int count);
+/* a sampler for count slots with the old one's values copied in,
+ * the old one is freed. NULL old is the same as _new() */
+cpufreq_sampler *cpufreq_sampler_grow(cpufreq_sampler *, int count);
+void cpufreq_sampler_free(cpufreq_sampler *);
+void cpufreq_read_limits(cpufreq_sampler *);
+void cpufreq_read_limits_from(cpufreq_sampler *, int first);
+int cpufreq_sample(cpufreq_sampler *);
+
+/* -- cpu lists, like "0-3,6,8-11" -- */
+char *cpu_online_list(void); /* /sys/devices/system/cpu/online, free() it */
+int cpulist_has(const char *list, int cpu);
+int cpulist_count(const char *list);
+/* puts up to max of the list's ids in ids, returns how many */
+int cpulist_ids(const char *list, int *ids, int max);
+
+/* -- parallel for --
+ * calls func(data, i) for each i in [0, count) from a few worker
+ * threads, returns when all are done. func must only write state
+ * that belongs to its own i, and must not use the
+ * get_file_contents_live() cache or intern strings. */
+typedef void (*parallel_func)(void *data, int i);
+void run_parallel(int count, parallel_func func, void *data);
+
+/* -- arena --
+ * owns many small allocations that all end together; nothing
+ * from it is freed alone. arena_reset() keeps the blocks for reuse. */
+typedef struct rpiz_arena rpiz_arena;
+
+rpiz_arena *arena_new(void);
+void *arena_alloc(rpiz_arena *a, int size);
+char *arena_strdup(rpiz_arena *a, const char *str);
+/* str need not be terminated */
+char *arena_strndup(rpiz_arena *a, const char *str, int len);
+void arena_reset(rpiz_arena *a);
+void arena_free(rpiz_arena *a);
+
 /* -- string structures used in cpu_*  -- */
 
 typedef struct {
     int ref_count;
     char *str;
+    unsigned int hash;
 } cpu_string;
 
+/* strs[] may move as the list grows, but each str does not */
 typedef struct {
     int count;
     cpu_string *strs;
+    int alloc;
+    int *index;         /* open addressing, strs[] position + 1, 0 is empty */
+    int index_size;     /* power of two */
+    rpiz_arena *arena;  /* if set, owns the strs[].str */
 } cpu_string_list;
 
 cpu_string_list *strlist_new(void);
+cpu_string_list *strlist_new_arena(rpiz_arena *a);
 void strlist_free(cpu_string_list *list);
 char *strlist_add_w(cpu_string_list *list, const char* str, int weight);
 char *strlist_add(cpu_string_list *list, const char* str);
+/* str need not be terminated */
+char *strlist_add_wn(cpu_string_list *list, const char* str, int len, int weight);
+char *strlist_add_n(cpu_string_list *list, const char* str, int len);
+/* NULL if not in the list */
+cpu_string *strlist_find(cpu_string_list *list, const char* str);
+cpu_string *strlist_find_n(cpu_string_list *list, const char* str, int len);
+/* position in strs[], or -1 */
+int strlist_pos(cpu_string_list *list, const char* str);
+/* every entry space-separated, in list order */
+char *strlist_join(rpiz_arena *a, cpu_string_list *list);
+
+/* -- flag sets --
+ * bit n of a set is entry n of a cpu_string_list of flag names */
+#define FLAGSET_WORDS(n) (((n) + 63) / 64)
+uint64_t *flagset_new(rpiz_arena *a, int words);
+void flagset_set(uint64_t *set, int bit);
+int flagset_test(const uint64_t *set, int bit);
+int flagset_count(const uint64_t *set, int words);
+/* space-separated names of the set bits, in list order */
+char *flagset_names(rpiz_arena *a, const uint64_t *set, int words, cpu_string_list *names);
+
+/* a set per cpu, and the flags only some online cpus have */
+typedef struct {
+    int count, words;
+    uint64_t **set; /* cpu i's, may be shared */
+    char *uncommon;
+} cpu_flag_sets;
+
+/* cpu i's flags are the strings flags[i * per + j], each word named
+ * prefix[j] followed by the word, or just the word if prefix is NULL.
+ * A cpu with the same strings as the one before shares its set, and
+ * online is a set over cpu index. Everything is made in a */
+int flag_sets_build(cpu_flag_sets *fs, rpiz_arena *a, int count, const char **flags, const char **prefix, int per, const uint64_t *online, cpu_string_list *names);
+
+/* skips spaces, points word at the next space-separated word
+ * and str past it. returns its length, 0 at the end */
+int str_next_word(const char **str, const char **word);
+
+/* -- static name tables --
+ * a hash index over the name column of a NULL-terminated table of
+ * structs. the first row with a name wins. */
+typedef struct {
+    const void *first;  /* &tab[0].name */
+    int stride;         /* sizeof(tab[0]) */
+    int nocase;
+    int size;           /* power of two, 0 until made */
+    short *slots;       /* row + 1, 0 is empty */
+} name_index;
+
+#define NAME_INDEX(tab, nocase) { &tab[0].name, sizeof(tab[0]), nocase, 0, NULL }
+
+/* once, before any lookup. under pthread_once() if the
+ * first lookup could be made from more than one thread */
+void name_index_make(name_index *ix);
+/* row, or -1 if not found or not made. name need not be terminated */
+int name_index_find(name_index *ix, const char *name, int len);
 
 /* -- key / value scan  -- */
 typedef struct kv_scan kv_scan;
 
+typedef struct {
+    const char *str; /* points into the scanned buffer, not terminated */
+    int len;
+} kv_slice;
+
+#define KV_TRIM 1 /* drop trailing white space from key and value */
+
 kv_scan *kv_new(char *buffer);
 kv_scan *kv_new_file(const char *file);
 int kv_next(kv_scan *, char **key, char **value);
+int kv_next_slice(kv_scan *, kv_slice *key, kv_slice *value, int flags);
 void kv_free(kv_scan *);
 
+int kv_slice_match(const kv_slice *, const char *str); /* prefix either way */
+int kv_slice_eq(const kv_slice *, const char *str);
+char *kv_slice_copy(const kv_slice *, char *buff, int buff_size);
+char *kv_slice_dup(const kv_slice *);
+
 #endif
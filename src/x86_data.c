@@ -21,7 +21,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "x86_data.h"
+#include "util.h"
 
 #ifndef _
 #define _(String) String
@@ -311,16 +313,29 @@ const char *x86_flag_list() {
     return all_flags;
 }
 
+/* table order, NULL past the end */
+const char *x86_flag_name(int index) {
+    /* less the NULL row */
+    const int count = sizeof(tab_flag_meaning) / sizeof(tab_flag_meaning[0]) - 1;
+    if (index < 0 || index >= count)
+        return NULL;
+    return tab_flag_meaning[index].name;
+}
+
+static name_index flag_index = NAME_INDEX(tab_flag_meaning, 0);
+static pthread_once_t flag_index_once = PTHREAD_ONCE_INIT;
+
+static void flag_index_make(void) {
+    name_index_make(&flag_index);
+}
+
 const char *x86_flag_meaning(const char *flag) {
-    int i = 0;
-    if (flag)
-    while(tab_flag_meaning[i].name != NULL) {
-        if (strcmp(tab_flag_meaning[i].name, flag) == 0) {
-            if (tab_flag_meaning[i].meaning != NULL)
-                return _(tab_flag_meaning[i].meaning);
-            else return NULL;
-        }
-        i++;
+    int i;
+    if (flag) {
+        pthread_once(&flag_index_once, flag_index_make);
+        i = name_index_find(&flag_index, flag, strlen(flag));
+        if (i >= 0 && tab_flag_meaning[i].meaning != NULL)
+            return _(tab_flag_meaning[i].meaning);
     }
     return NULL;
 }
@@ -24,5 +24,6 @@
 /* cpu flags from /proc/cpuinfo */
 const char *x86_flag_list(void);                 /* list of all known flags */
 const char *x86_flag_meaning(const char *flag);  /* lookup flag meaning */
+const char *x86_flag_name(int index);            /* known flags, in order */
 
 #endif
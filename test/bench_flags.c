@@ -0,0 +1,90 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* time per flag meaning lookup, for each name in each table and for
+ * names not in it, by the hash index and by the strcmp() scan of the
+ * table the lookups used before it */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/util.h"
+#include "../src/arm_data.h"
+#include "../src/x86_data.h"
+#include "../src/riscv_data.h"
+
+#define ROUNDS 2000
+
+typedef const char *(*name_func)(int index);
+typedef const char *(*meaning_func)(const char *name);
+
+static volatile int sink;
+
+static int scan_lookup(const char **names, int count, const char *name) {
+    int i;
+    for (i = 0; i < count; i++)
+        if (strcmp(names[i], name) == 0)
+            return i;
+    return -1;
+}
+
+static void bench(const char *what, name_func name_at, meaning_func meaning) {
+    static const char *missing[] = { "nosuchflag", "sse9", "zz", "fpux", NULL };
+    const char **names;
+    double start, index_ns, scan_ns;
+    int count, lookups, i, r;
+
+    for (count = 0; name_at(count); count++);
+    names = malloc(sizeof(char*) * (count + 1));
+    if (!names) return;
+    for (i = 0; i < count; i++)
+        names[i] = name_at(i);
+    lookups = ROUNDS * (count + 4);
+    meaning(name_at(0)); /* the index is made */
+
+    start = monotonic_seconds();
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < count; i++)
+            sink += (meaning(names[i]) != NULL);
+        for (i = 0; missing[i]; i++)
+            sink += (meaning(missing[i]) != NULL);
+    }
+    index_ns = (monotonic_seconds() - start) * 1e9 / lookups;
+
+    start = monotonic_seconds();
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < count; i++)
+            sink += scan_lookup(names, count, names[i]);
+        for (i = 0; missing[i]; i++)
+            sink += scan_lookup(names, count, missing[i]);
+    }
+    scan_ns = (monotonic_seconds() - start) * 1e9 / lookups;
+
+    printf("%-6s %4d names %8.2f ns/lookup indexed %8.2f ns/lookup scanned\n",
+        what, count, index_ns, scan_ns);
+    free(names);
+}
+
+int main(void) {
+    bench("x86", x86_flag_name, x86_flag_meaning);
+    bench("arm", arm_flag_name, arm_flag_meaning);
+    bench("riscv", riscv_ext_name, riscv_ext_meaning);
+    return 0;
+}
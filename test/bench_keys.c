@@ -0,0 +1,115 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* time per cpuinfo line over the dumps given: the key looked up by
+ * cpuinfo_key_lookup(), the same keys through the strncmp() chain the
+ * x86 backend used before it, and whole files read by a cpu_proc */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/util.h"
+#include "../src/cpuinfo.h"
+#include "../src/cpu.h"
+
+#define ROUNDS 200
+
+/* as scan_cpu() in cpu_x86.c matched keys before cpuinfo_key_lookup() */
+#define CHECK_FOR(k) (strncmp(k, key, (strlen(k) < strlen(key)) ? strlen(k) : strlen(key)) == 0)
+
+static int chain_lookup(const char *key) {
+    if (CHECK_FOR("Processor")) return 1;
+    if (CHECK_FOR("processor")) return 2;
+    if (CHECK_FOR("model name")) return 3;
+    if (CHECK_FOR("physical id")) return 4;
+    if (CHECK_FOR("core id")) return 5;
+    if (CHECK_FOR("flags")) return 6;
+    if (CHECK_FOR("bugs")) return 7;
+    if (CHECK_FOR("power management")) return 8;
+    if (CHECK_FOR("fdiv_bug")) return 9;
+    if (CHECK_FOR("hlt_bug")) return 10;
+    if (CHECK_FOR("f00f_bug")) return 11;
+    if (CHECK_FOR("coma_bug")) return 12;
+    return 0;
+}
+
+static char **keys;
+static int key_count, key_alloc;
+
+static int add_keys(const char *path) {
+    kv_scan *kv;
+    kv_slice k, v;
+    kv = kv_new_file(path);
+    if (!kv) return 0;
+    while (kv_next_slice(kv, &k, &v, KV_TRIM)) {
+        if (key_count == key_alloc) {
+            key_alloc = key_alloc ? key_alloc * 2 : 1024;
+            keys = realloc(keys, sizeof(char*) * key_alloc);
+            if (!keys) exit(1);
+        }
+        keys[key_count++] = strndup(k.str, k.len);
+    }
+    kv_free(kv);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    volatile int sink = 0;
+    double start, ns;
+    cpu_proc *p;
+    int i, r;
+
+    for (i = 1; i < argc; i++)
+        if (!add_keys(argv[i])) {
+            fprintf(stderr, "%s: can't be read\n", argv[i]);
+            return 1;
+        }
+    printf("%d dumps, %d lines, %d rounds\n", argc - 1, key_count, ROUNDS);
+    if (!key_count) return 0;
+
+    start = monotonic_seconds();
+    for (r = 0; r < ROUNDS; r++)
+        for (i = 0; i < key_count; i++)
+            sink += cpuinfo_key_lookup(keys[i], strlen(keys[i]));
+    ns = (monotonic_seconds() - start) * 1e9 / ROUNDS / key_count;
+    printf("%-20s %8.2f ns/line\n", "cpuinfo_key_lookup", ns);
+
+    start = monotonic_seconds();
+    for (r = 0; r < ROUNDS; r++)
+        for (i = 0; i < key_count; i++)
+            sink += chain_lookup(keys[i]);
+    ns = (monotonic_seconds() - start) * 1e9 / ROUNDS / key_count;
+    printf("%-20s %8.2f ns/line\n", "strncmp chain", ns);
+
+    start = monotonic_seconds();
+    for (r = 0; r < ROUNDS; r++)
+        for (i = 1; i < argc; i++) {
+            p = cpu_proc_new_file(argv[i]);
+            sink += (p != NULL);
+            cpu_proc_free(p);
+        }
+    ns = (monotonic_seconds() - start) * 1e9 / ROUNDS / key_count;
+    printf("%-20s %8.2f ns/line\n", "cpu_proc_new_file", ns);
+
+    for (i = 0; i < key_count; i++)
+        free(keys[i]);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* counts the heap calls of what a GUI refresh reads: each cpu's clock,
+ * the sysfs ints behind it, the SoC temperature and every live field.
+ * A file every machine has is read both ways, to show what the
+ * malloc'd get_file_contents() costs where cpufreq is missing */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/util.h"
+#include "../src/board.h"
+#include "../src/board_rpi.h"
+#include "../src/cpu.h"
+#include "../src/cache.h"
+#include "../src/numa.h"
+
+#define REFRESHES 1000
+
+/* glibc lets malloc be replaced, its own calls come here too */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static long allocs;
+
+void *malloc(size_t size) {
+    allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    allocs++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+static void cpu_clocks(void) {
+    cpu_freq_sample();
+}
+
+static void cpu_ints(void) {
+    int c;
+    for (c = 0; c < cpu_cores(); c++) {
+        get_cpu_int("cpufreq/scaling_max_freq", cpu_core_id(c));
+        get_cpu_int_live("cpufreq/scaling_cur_freq", cpu_core_id(c));
+    }
+}
+
+static void soc_temp(void) {
+    rpi_soc_temp();
+}
+
+#define ONLINE "/sys/devices/system/cpu/online"
+
+static void file_buf(void) {
+    char buff[64];
+    get_file_contents_buf(ONLINE, buff, sizeof(buff));
+}
+
+static void file_malloc(void) {
+    free(get_file_contents(ONLINE));
+}
+
+static rpiz_fields *all_fields;
+
+/* every live field, as if each was due */
+static void live_fields(void) {
+    char *tag, *value;
+    int i;
+    for (i = 0; i < fields_count(all_fields); i++) {
+        fields_get_at(all_fields, i, &tag, NULL, NULL);
+        if (fields_islive(all_fields, tag))
+            fields_get_at(all_fields, i, NULL, NULL, &value);
+    }
+}
+
+static void bench(const char *what, void (*refresh)(void)) {
+    double start;
+    long before;
+    int r;
+    refresh(); /* files opened, buffers made */
+    before = allocs;
+    start = monotonic_seconds();
+    for (r = 0; r < REFRESHES; r++)
+        refresh();
+    printf("%-14s %8.2f allocs/refresh %10.2f us/refresh\n", what,
+        (double)(allocs - before) / REFRESHES,
+        (monotonic_seconds() - start) * 1e6 / REFRESHES);
+}
+
+int main(void) {
+    rpiz_fields *parts[4];
+    board_init();
+    cpu_init();
+    cache_init();
+    numa_init();
+    parts[0] = board_fields();
+    parts[1] = cpu_fields();
+    parts[2] = cache_fields();
+    parts[3] = numa_fields();
+    all_fields = fields_view_new(parts, 4);
+
+    printf("%d cpus, %d refreshes\n", cpu_cores(), REFRESHES);
+    bench("cpu clocks", cpu_clocks);
+    bench("cpu ints", cpu_ints);
+    bench("soc temp", soc_temp);
+    bench("live fields", live_fields);
+    bench("file, buffer", file_buf);
+    bench("file, malloc", file_malloc);
+
+    fields_free(all_fields);
+    cache_cleanup();
+    numa_cleanup();
+    board_cleanup();
+    cpu_cleanup();
+    live_cache_flush();
+    return 0;
+}
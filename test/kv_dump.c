@@ -0,0 +1,44 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* prints every key and value kv_scan finds in each file, untrimmed,
+ * for comparing the scanner builds in the Makefile */
+
+#include <stdio.h>
+#include "../src/util.h"
+
+int main(int argc, char *argv[]) {
+    kv_scan *kv;
+    kv_slice k, v;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        kv = kv_new_file(argv[i]);
+        if (!kv) {
+            fprintf(stderr, "%s: can't be read\n", argv[i]);
+            return 1;
+        }
+        printf("# %s\n", argv[i]);
+        while (kv_next_slice(kv, &k, &v, 0))
+            printf("[%.*s] [%.*s]\n", k.len, k.str, v.len, v.str);
+        kv_free(kv);
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * rpiz - https://github.com/bp0/rpiz
+ * Copyright (C) 2017  Burt P. <pburt0@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/* writes a 1024 cpu cpuinfo for each backend, then checks every cpu
+ * was read and that a flag on one cpu only is found as uncommon */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/cpu.h"
+
+#define MANY 1024
+
+static const char *tmp_path = "many_cores.tmp";
+
+static void write_x86(FILE *fp, int i) {
+    fprintf(fp, "processor\t: %d\n", i);
+    fprintf(fp, "vendor_id\t: GenuineIntel\n");
+    fprintf(fp, "cpu family\t: 6\n");
+    fprintf(fp, "model\t\t: 143\n");
+    fprintf(fp, "model name\t: Synthetic Many-Core Processor\n");
+    fprintf(fp, "physical id\t: %d\n", i / 256);
+    fprintf(fp, "siblings\t: 256\n");
+    fprintf(fp, "core id\t\t: %d\n", (i % 256) / 2);
+    fprintf(fp, "cpu cores\t: 128\n");
+    fprintf(fp, "flags\t\t: fpu tsc msr sse sse2 ht%s\n", (i == MANY - 1) ? " manyflag" : "");
+    fprintf(fp, "bugs\t\t: spectre_v1\n\n");
+}
+
+static void write_arm(FILE *fp, int i) {
+    fprintf(fp, "processor\t: %d\n", i);
+    fprintf(fp, "BogoMIPS\t: 50.00\n");
+    fprintf(fp, "Features\t: fp asimd evtstrm crc32 cpuid%s\n", (i == MANY - 1) ? " manyflag" : "");
+    fprintf(fp, "CPU implementer\t: 0x41\n");
+    fprintf(fp, "CPU architecture: 8\n");
+    fprintf(fp, "CPU variant\t: 0x1\n");
+    fprintf(fp, "CPU part\t: 0xd0c\n");
+    fprintf(fp, "CPU revision\t: 1\n\n");
+}
+
+static void write_riscv(FILE *fp, int i) {
+    fprintf(fp, "processor\t: %d\n", i);
+    fprintf(fp, "hart\t\t: %d\n", i);
+    fprintf(fp, "isa\t\t: rv64imafdc%s\n", (i == MANY - 1) ? "v" : "");
+    fprintf(fp, "mmu\t\t: sv39\n\n");
+}
+
+static int check(const char *arch, void (*write_cpu)(FILE *, int), const char *every, const char *one) {
+    cpu_proc *p;
+    const char *uncommon;
+    FILE *fp;
+    int i, ok = 1;
+
+    fp = fopen(tmp_path, "w");
+    if (!fp) {
+        fprintf(stderr, "%s: can't be written\n", tmp_path);
+        return 0;
+    }
+    for (i = 0; i < MANY; i++)
+        write_cpu(fp, i);
+    fclose(fp);
+
+    p = cpu_proc_new_file(tmp_path);
+    remove(tmp_path);
+    if (!p || strcmp(cpu_proc_arch(p), arch) != 0) {
+        fprintf(stderr, "%s: %d cpus not read as %s\n", arch, MANY, arch);
+        cpu_proc_free(p);
+        return 0;
+    }
+    if (cpu_proc_cores(p) != MANY) {
+        fprintf(stderr, "%s: %d of %d cpus read\n", arch, cpu_proc_cores(p), MANY);
+        ok = 0;
+    }
+    if (cpu_proc_core_id(p, MANY - 1) != MANY - 1) {
+        fprintf(stderr, "%s: the last cpu is %d\n", arch, cpu_proc_core_id(p, MANY - 1));
+        ok = 0;
+    }
+    if (cpu_proc_has_flag(p, every) != MANY || cpu_proc_has_flag(p, one) != 1) {
+        fprintf(stderr, "%s: %s on %d, %s on %d\n", arch,
+            every, cpu_proc_has_flag(p, every), one, cpu_proc_has_flag(p, one));
+        ok = 0;
+    }
+    uncommon = cpu_proc_uncommon_flags(p);
+    if (!uncommon || !strstr(uncommon, one)) {
+        fprintf(stderr, "%s: %s is not uncommon\n", arch, one);
+        ok = 0;
+    }
+    cpu_proc_free(p);
+    return ok;
+}
+
+int main(void) {
+    int ok = 1;
+    ok &= check("x86", write_x86, "sse2", "manyflag");
+    ok &= check("arm", write_arm, "asimd", "manyflag");
+    ok &= check("riscv", write_riscv, "F", "V");
+    if (!ok) return 1;
+    printf("cpu_proc: %d cpus read by each backend\n", MANY);
+    return 0;
+}